@@ -0,0 +1,54 @@
+#include "arena.h"
+
+RenderArena::RenderArena(size_t initialSize):
+  initialBlock(new char[initialSize]),
+  arena(initialBlock.get(), initialSize, &heap)
+{
+  heap.numAllocations = &stats.numHeapAllocations;
+}
+
+void RenderArena::reset()
+{
+  arena.release();
+  stats = ArenaStats();
+}
+
+void* RenderArena::do_allocate(size_t bytes, size_t alignment)
+{
+  stats.numAllocations++;
+  stats.numBytes += bytes;
+  return arena.allocate(bytes, alignment);
+}
+
+void RenderArena::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+  // Memory is only given back on reset
+  arena.deallocate(p, bytes, alignment);
+}
+
+bool RenderArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+  return this == &other;
+}
+
+void* RenderArena::HeapResource::do_allocate(size_t bytes, size_t alignment)
+{
+  (*numAllocations)++;
+  return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void RenderArena::HeapResource::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+  std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool RenderArena::HeapResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+  return this == &other;
+}
+
+RenderArena& getRenderArena()
+{
+  thread_local RenderArena arena;
+  return arena;
+}
@@ -0,0 +1,54 @@
+#ifndef ARENA
+#define ARENA
+
+#include <stddef.h>
+#include <memory>
+#include <memory_resource>
+
+// Render arenas
+//
+// Temporaries of a single render, like markdown lines and the scope, loop
+// and include stacks, are allocated from a monotonic arena owned by the
+// render thread and released once the output file is written. The first
+// block is kept from one render to the next, so the heap is only used when
+// a render outgrows it.
+
+struct ArenaStats
+{
+  size_t numAllocations = 0;
+  size_t numBytes = 0;
+  size_t numHeapAllocations = 0;  // blocks the arena had to get from the heap
+};
+
+struct RenderArena : std::pmr::memory_resource
+{
+  explicit RenderArena(size_t initialSize = 256 * 1024);
+
+  // Frees everything allocated since the last reset and clears the stats
+  void reset();
+
+  ArenaStats stats;
+
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+  // Counts the blocks the monotonic resource gets from the heap
+  struct HeapResource : std::pmr::memory_resource
+  {
+    size_t* numAllocations = nullptr;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+  };
+
+  std::unique_ptr<char[]> initialBlock;
+  HeapResource heap;
+  std::pmr::monotonic_buffer_resource arena;
+};
+
+// The arena of the calling thread
+RenderArena& getRenderArena();
+
+#endif  // ARENA
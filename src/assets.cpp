@@ -0,0 +1,327 @@
+#include <filesystem>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <stdio.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#endif
+#include "assets.h"
+#include "parallel.h"
+#include "parser_utils.h"
+#include "site.h"
+#include "trace.h"
+
+// Asset sync
+//
+// Template and post assets are copied to the output assets directory only
+// when the copy is missing or differs in size or modification time from the
+// source. Copies keep the source modification time, so telling them apart
+// never requires reading file contents.
+
+enum AssetResult
+{
+  ASSET_FAILED    = 0,
+  ASSET_UNCHANGED = 1,
+  ASSET_COPIED    = 2,
+};
+
+// Copies the file contents letting the kernel do the work when possible:
+// a reflink on file systems that share extents between files, or
+// copy_file_range otherwise, which never moves the data through user space.
+bool copyFileContents(const std::filesystem::path& from, const std::filesystem::path& to, uintmax_t size)
+{
+#ifdef __linux__
+  int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0)
+    return false;
+
+  struct stat sourceStat;
+  mode_t mode = fstat(in, &sourceStat) == 0 ? sourceStat.st_mode & 0777 : 0644;
+  int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+  if (out < 0)
+  {
+    close(in);
+    return false;
+  }
+
+  bool copied = ioctl(out, FICLONE, in) == 0;
+  uintmax_t numCopied = 0;
+  while (!copied && numCopied < size)
+  {
+    ssize_t count = copy_file_range(in, nullptr, out, nullptr, size - numCopied, 0);
+    if (count <= 0)
+      break;
+    numCopied += count;
+  }
+
+  copied = copied || numCopied == size;
+  copied = close(out) == 0 && copied;
+  close(in);
+  if (copied)
+    return true;
+#endif
+
+  // Cross device copies on older kernels and other platforms
+  std::error_code error;
+  return std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing, error);
+}
+
+AssetResult copyAssetFile(const AssetFile& asset)
+{
+  TraceSpan span("copy asset", traceDetail(asset.source));
+  std::error_code error;
+  std::filesystem::file_status status = std::filesystem::status(asset.destination, error);
+  if (std::filesystem::is_regular_file(status)
+      && std::filesystem::file_size(asset.destination, error) == asset.size && !error
+      && std::filesystem::last_write_time(asset.destination, error) == asset.lastWriteTime && !error)
+    return ASSET_UNCHANGED;
+
+  // Copy next to the destination and rename it over, so an interrupted copy
+  // is never mistaken for an up to date one
+  std::filesystem::path tempFileName = asset.destination;
+  tempFileName += ".tmp";
+  if (!copyFileContents(asset.source, tempFileName, asset.size))
+  {
+    std::filesystem::remove(tempFileName, error);
+    return ASSET_FAILED;
+  }
+
+  std::filesystem::last_write_time(tempFileName, asset.lastWriteTime, error);
+  std::filesystem::rename(tempFileName, asset.destination, error);
+  if (error)
+  {
+    std::filesystem::remove(tempFileName, error);
+    return ASSET_FAILED;
+  }
+  return ASSET_COPIED;
+}
+
+AssetResult syncAssetFile(const AssetFile& asset, SizeStats* gzip)
+{
+  AssetResult result = copyAssetFile(asset);
+  if (result != ASSET_FAILED && !syncGzipSibling(asset.destination.string(), nullptr, result == ASSET_COPIED, gzip))
+    return ASSET_FAILED;
+  return result;
+}
+
+// Post level assets override template level assets with the same path
+void collectAssets(const std::filesystem::path& assetsDirectory,
+    std::vector<AssetFile>& assets,
+    std::unordered_map<std::string, size_t>& assetIndices)
+{
+  std::error_code error;
+  for (auto& entry : std::filesystem::recursive_directory_iterator(assetsDirectory, error))
+  {
+    std::error_code entryError;
+    if (!entry.is_regular_file(entryError))
+      continue;
+
+    AssetFile asset;
+    asset.source = entry.path();
+    asset.path = entry.path().lexically_relative(assetsDirectory).generic_string();
+    asset.size = entry.file_size(entryError);
+    asset.lastWriteTime = entry.last_write_time(entryError);
+    if (entryError)
+      continue;
+
+    auto it = assetIndices.emplace(asset.path, assets.size());
+    if (it.second)
+      assets.push_back(std::move(asset));
+    else
+      assets[it.first->second] = std::move(asset);
+  }
+}
+
+// Removes the copies of assets that are no longer a destination, with the
+// directories they leave empty. Returns how many assets were removed, not
+// counting their gzip siblings.
+size_t removeStaleAssets(const std::filesystem::path& outputAssetsDirectory,
+    const std::unordered_set<std::string>& destinations)
+{
+  std::set<std::filesystem::path> staleFiles;
+  std::error_code error;
+  for (auto& entry : std::filesystem::recursive_directory_iterator(outputAssetsDirectory, error))
+  {
+    std::error_code entryError;
+    if (!entry.is_regular_file(entryError))
+      continue;
+
+    // The gzip sibling of an asset is kept along with it
+    std::string fileName = entry.path().string();
+    if (destinations.count(fileName) ||
+        (fileName.ends_with(".gz") && destinations.count(fileName.substr(0, fileName.length() - 3))))
+      continue;
+
+    staleFiles.insert(entry.path());
+  }
+
+  size_t numRemoved = 0;
+  std::set<std::filesystem::path> staleDirectories;
+  for (const std::filesystem::path& file : staleFiles)
+  {
+    bool isSibling = file.extension() == ".gz" && staleFiles.count(std::filesystem::path(file).replace_extension());
+    if (std::filesystem::remove(file, error) && !isSibling)
+      numRemoved++;
+    staleDirectories.insert(file.parent_path());
+  }
+
+  for (auto it = staleDirectories.rbegin(); it != staleDirectories.rend(); ++it)
+  {
+    // Removing a directory which is not empty fails, which stops the walk up
+    for (std::filesystem::path directory = *it; directory != outputAssetsDirectory && directory.has_relative_path();
+        directory = directory.parent_path())
+    {
+      if (!std::filesystem::remove(directory, error))
+        break;
+    }
+  }
+  return numRemoved;
+}
+
+// Asset fingerprints
+//
+// With site.fingerprint_assets = "true", assets are copied to names carrying
+// a hash of their contents, like assets/default.3f9a1c4b.css, so they can be
+// served with long lived cache headers. Templates link them with
+// {{asset "default.css"}}, resolved through the asset urls, which are known
+// before rendering starts.
+
+// Inserts the hash before the extension: css/default.css becomes css/default.3f9a1c4b.css
+std::string getFingerprintedPath(const std::string& path, uint64_t hash)
+{
+  char fingerprint[16];
+  snprintf(fingerprint, sizeof(fingerprint), ".%08llx", (unsigned long long) (hash >> 32));
+
+  size_t nameStart = path.rfind('/') + 1;
+  size_t dot = path.rfind('.');
+  if (dot == std::string::npos || dot <= nameStart)
+    return path + fingerprint;
+
+  return path.substr(0, dot) + fingerprint + path.substr(dot);
+}
+
+void collectSiteAssets(Site& site)
+{
+  TraceSpan span("collect assets");
+  std::vector<AssetFile> assets;
+  std::unordered_map<std::string, size_t> assetIndices;
+  collectAssets(site.templateDirectory / "assets", assets, assetIndices);
+  collectAssets(site.postsDirectory / "assets", assets, assetIndices);
+
+  auto fingerprintIt = site.variables.find("site.fingerprint_assets");
+  bool fingerprint = fingerprintIt != site.variables.end() && fingerprintIt->second == "true";
+  const AssetIndex& previousIndex = site.assetIndex;
+  if (fingerprint)
+  {
+    parallelFor(assets.size(), site.options.numJobs, [&](size_t i)
+    {
+      AssetFile& asset = assets[i];
+      auto it = previousIndex.find(asset.source.string());
+      if (it != previousIndex.end() && it->second.size == asset.size
+          && it->second.lastWriteTime == (int64_t) asset.lastWriteTime.time_since_epoch().count())
+      {
+        asset.hash = it->second.hash;
+        return;
+      }
+
+      TraceSpan span("hash asset", traceDetail(asset.source));
+      FileBuffer file;
+      if (file.open(asset.source.string().c_str()))
+        asset.hash = hashBuffer(file.data(), file.size());
+      else
+        logErrorFmt("Could not read asset %s\n", asset.source.string().c_str());
+    });
+  }
+
+  AssetIndex index;
+  site.assetUrls.clear();
+  for (AssetFile& asset : assets)
+  {
+    std::string url = "assets/" + (fingerprint ? getFingerprintedPath(asset.path, asset.hash) : asset.path);
+    asset.destination = site.outputDirectory / url;
+    site.assetUrls[asset.path] = url;
+    if (fingerprint)
+      index[asset.source.string()] = {(int64_t) asset.lastWriteTime.time_since_epoch().count(), asset.size, asset.hash};
+  }
+
+  site.assets = std::move(assets);
+  site.assetIndex = std::move(index);
+  if (site.options.incremental)
+    saveAssetIndex(site.options.cacheDirectory, site.assetIndex);
+}
+
+void copyAssets(Site& site)
+{
+  TraceSpan span("copy assets");
+  logVerbose("Copying assets ...\n");
+  std::filesystem::path outputAssetsDirectory = site.outputDirectory / "assets";
+  const std::vector<AssetFile>& assets = site.assets;
+
+  // Directories are created up front, so copies can run in parallel
+  std::set<std::filesystem::path> directories;
+  for (const AssetFile& asset : assets)
+    directories.insert(asset.destination.parent_path());
+
+  for (const std::filesystem::path& directory : directories)
+  {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+  }
+
+  std::vector<AssetResult> results(assets.size(), ASSET_FAILED);
+  SizeStats gzipStats;
+  SizeStats* gzip = site.options.gzip ? &gzipStats : nullptr;
+  parallelFor(assets.size(), site.options.numJobs, [&](size_t i)
+  {
+    results[i] = syncAssetFile(assets[i], gzip);
+  });
+
+  size_t numCopied = 0;
+  size_t numUnchanged = 0;
+  uintmax_t bytesCopied = 0;
+  for (size_t i = 0; i < assets.size(); i++)
+  {
+    if (results[i] == ASSET_FAILED)
+    {
+      logErrorFmt("Could not copy asset %s\n", assets[i].source.string().c_str());
+    }
+    else if (results[i] == ASSET_COPIED)
+    {
+      numCopied++;
+      bytesCopied += assets[i].size;
+    }
+    else
+    {
+      numUnchanged++;
+    }
+  }
+
+  // Stale copies, including the ones of older fingerprints, are removed once
+  // the current ones are in place. Full builds start from an empty output
+  // directory and have none.
+  size_t numRemoved = 0;
+  if (site.options.incremental || site.options.watch)
+  {
+    std::unordered_set<std::string> destinations;
+    for (const AssetFile& asset : assets)
+      destinations.insert(asset.destination.string());
+    numRemoved = removeStaleAssets(outputAssetsDirectory, destinations);
+  }
+
+  site.stats.numAssetsCopied = numCopied;
+  site.stats.numAssetsUnchanged = numUnchanged;
+  site.stats.numAssetsRemoved = numRemoved;
+  site.stats.assetBytesCopied = bytesCopied;
+
+  // Added to the outputs gzipped by the render
+  site.stats.numGzipped += gzipStats.numFiles;
+  site.stats.gzipInputBytes += gzipStats.inputBytes;
+  site.stats.gzipOutputBytes += gzipStats.outputBytes;
+}
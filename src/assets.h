@@ -0,0 +1,30 @@
+#ifndef ASSETS
+#define ASSETS
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+struct Site;
+
+struct AssetFile
+{
+  std::filesystem::path source;
+  std::filesystem::path destination;
+  std::string path;  // Relative to the assets directory, with / separators
+  uintmax_t size;
+  std::filesystem::file_time_type lastWriteTime;
+  uint64_t hash = 0;  // Only known when fingerprinting
+};
+
+// Lists the template and post assets and resolves the output url of each.
+// When fingerprinting, assets missing from the asset index or changed since
+// are hashed in parallel.
+void collectSiteAssets(Site& site);
+
+// Copies the assets listed by collectSiteAssets that changed to their output
+// names. Incremental builds and watch mode rebuilds also remove the copies
+// of assets that are gone.
+void copyAssets(Site& site);
+
+#endif  // ASSETS
@@ -0,0 +1,31 @@
+#ifndef BENCH
+#define BENCH
+
+#include <chrono>
+#include <filesystem>
+
+struct SyntheticSiteOptions;
+
+// Returns how many seconds it takes to run f once
+template<typename F>
+double benchSeconds(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+void benchInlineMarkdown();
+
+void benchMarkdownDocument(const SyntheticSiteOptions& options);
+
+void benchGetToken();
+
+void benchTemplateScan(std::filesystem::path templateDirectory);
+
+void benchTemplateRender(std::filesystem::path templateDirectory);
+
+void benchFullBuild(std::filesystem::path siteDirectory, std::filesystem::path outputDirectory, size_t numPosts);
+
+#endif  // BENCH
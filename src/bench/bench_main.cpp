@@ -0,0 +1,76 @@
+#include <cstdlib>
+#include <string>
+#include <stdio.h>
+#include "bench.h"
+#include "synthetic_site.h"
+
+static void printUsage(const char* programName)
+{
+  printf("%s [options]\n", programName);
+  printf("Options:\n");
+  printf("  --posts N\t\tNumber of posts of the synthetic site. Default is 1000.\n");
+  printf("  --words MIN MAX\tRange of words per post. Default is 200 2000.\n");
+  printf("  --include-depth N\tNested includes on every page. Default is 3.\n");
+  printf("  --loops N\t\tLoops over all posts on the index page. Default is 2.\n");
+  printf("  --dir DIR\t\tWhere to write the synthetic site and its output. Default is a temp directory.\n");
+  printf("  --generate DIR\tOnly write the synthetic site to DIR.\n");
+  printf("  --templates DIR\tLayouts to measure the expression scan on. Default is the synthetic site templates.\n");
+}
+
+int main(int argc, char** argv)
+{
+  SyntheticSiteOptions options;
+  std::filesystem::path workDirectory = std::filesystem::temp_directory_path() / "static_bench";
+  std::filesystem::path generateDirectory;
+  std::filesystem::path scanDirectory;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "--posts" && i + 1 < argc)
+      options.numPosts = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--words" && i + 2 < argc)
+    {
+      options.minPostWords = std::strtoul(argv[++i], nullptr, 10);
+      options.maxPostWords = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else if (arg == "--include-depth" && i + 1 < argc)
+      options.includeDepth = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--loops" && i + 1 < argc)
+      options.loopsPerPage = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--dir" && i + 1 < argc)
+      workDirectory = argv[++i];
+    else if (arg == "--generate" && i + 1 < argc)
+      generateDirectory = argv[++i];
+    else if (arg == "--templates" && i + 1 < argc)
+      scanDirectory = argv[++i];
+    else
+    {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!generateDirectory.empty())
+    return generateSyntheticSite(generateDirectory, options) ? 0 : 1;
+
+  std::filesystem::path siteDirectory = std::filesystem::absolute(workDirectory / "site");
+  std::filesystem::path outputDirectory = std::filesystem::absolute(workDirectory / "output");
+  bool generated = false;
+  double seconds = benchSeconds([&]()
+  {
+    generated = generateSyntheticSite(siteDirectory, options);
+  });
+
+  if (!generated)
+    return 1;
+
+  printf("generate site           %8.3f s   %zu posts\n", seconds, options.numPosts);
+  benchGetToken();
+  benchTemplateScan(scanDirectory.empty() ? siteDirectory / "template" : scanDirectory);
+  benchTemplateRender(siteDirectory / "template");
+  benchInlineMarkdown();
+  benchMarkdownDocument(options);
+  benchFullBuild(siteDirectory, outputDirectory, options.numPosts);
+  return 0;
+}
@@ -0,0 +1,205 @@
+// Markdown benchmarks
+//
+// Compares the single pass inline scanner against the std::regex based
+// implementation it replaced, for short lines and for increasingly long ones,
+// and measures whole document conversion on synthetic posts, with and
+// without a render arena.
+
+#include <chrono>
+#include <regex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "../arena.h"
+#include "../markdown.h"
+#include "bench.h"
+#include "synthetic_site.h"
+
+using namespace std;
+
+namespace legacy
+{
+  string replaceScapeSequences(string line)
+  {
+    size_t pos = line.find("\\");
+    while (pos != string::npos)
+    {
+      if(line[pos+1] == '_')
+        line.replace(pos, 2, "&#95;");
+      else if(line[pos+1] == '[')
+        line.replace(pos, 2, "&#91;");
+      else if(line[pos+1] == ']')
+        line.replace(pos, 2, "&#93;");
+      else if(line[pos+1] == '<')
+        line.replace(pos, 2, "&lt;");
+      else if(line[pos+1] == '>')
+        line.replace(pos, 2, "&gt;");
+      else if(line[pos+1] == '(')
+        line.replace(pos, 2, "&#10098;");
+      else if(line[pos+1] == ')')
+        line.replace(pos, 2, "&#10099;");
+      else if(line[pos+1] == '\\')
+        line.replace(pos, 2, "&#92;");
+
+      pos = line.find("\\", pos+1);
+    }
+
+    return line;
+  }
+
+  string getLink(const string&& line) 
+  {
+    smatch match;
+
+    if(line.find("](") != string::npos)
+    {
+      static regex pattern("(.*)\\[(.*)\\]\\((.*)\\)(.*)");
+      if (regex_search(line, match, pattern)) 
+      {
+        return getLink(match[1].str()) + "<a href=\"" + match[3].str() + "\">" + match[2].str() + "</a>" + getLink(match[4].str());
+      }
+    }
+    return line;
+  }
+
+  string getImage(const string& line) 
+  {
+    smatch match;
+
+    if(line.find("![") != string::npos)
+    {
+      static regex pattern("(.*)!\\[(.*)\\]\\((.*)\\)(.*)");
+      if (regex_search(line, match, pattern)) 
+      {
+        return match[1].str() + "<img src=\"" + match[3].str() + "\" alt=\"" + match[2].str() + "\">" + match[4].str();
+      }
+    }
+    return line;
+  }
+
+  string getEmphasis(const string&& line) 
+  {
+    if (line.find_first_of("*_~") != string::npos)
+    {
+      static regex strongPattern("(\\*\\*|__)(.*?)\\1");
+      string result = regex_replace(line, strongPattern, "<strong>$2</strong>");
+
+      static regex emPattern("(_|\\*)(.*?)\\1");
+      result = regex_replace(result, emPattern, "<em>$2</em>");
+
+      static regex strikPattern("(\\~\\~)(.*?)\\1");
+      result = regex_replace(result, strikPattern, "<s>$2</s>");
+      return result;
+    }
+
+    return line;
+  }
+
+  string getSpanLevelFormatting(const string& line)
+  {
+    return getEmphasis(replaceScapeSequences(getLink(getImage(line))));
+  }
+}
+
+static string makeLine(size_t length, unsigned& seed)
+{
+  static const char* fragments[] =
+  {
+    "lorem ipsum ", "dolor sit amet ", "**strong text** ", "*emphasis* ", "~~strike~~ ",
+    "[a link](http://example.com/page.html) ", "\\_escaped\\_ ", "__bold__ ", "plain words here ",
+  };
+  const size_t numFragments = sizeof(fragments) / sizeof(fragments[0]);
+
+  string line;
+  while (line.length() < length)
+  {
+    seed = seed * 1103515245 + 12345;
+    line += fragments[(seed >> 16) % numFragments];
+  }
+  return line;
+}
+
+static void runCase(size_t lineLength, size_t totalBytes)
+{
+  unsigned seed = 1;
+  vector<string> lines;
+  size_t bytes = 0;
+  while (bytes < totalBytes)
+  {
+    lines.push_back(makeLine(lineLength, seed));
+    bytes += lines.back().length();
+  }
+
+  size_t checksum = 0;
+  double regexSeconds = benchSeconds([&]()
+  {
+    for (const string& line : lines)
+      checksum += legacy::getSpanLevelFormatting(line).length();
+  });
+
+  double scannerSeconds = benchSeconds([&]()
+  {
+    string out;
+    for (const string& line : lines)
+    {
+      out.clear();
+      appendSpanLevelFormatting(out, line);
+      checksum += out.length();
+    }
+  });
+
+  printf("inline markdown  line %6zu bytes   regex %8.2f MB/s   scanner %8.2f MB/s   %6.1fx  (%zu)\n",
+      lineLength,
+      bytes / regexSeconds / 1e6,
+      bytes / scannerSeconds / 1e6,
+      regexSeconds / scannerSeconds,
+      checksum % 10);
+}
+
+void benchInlineMarkdown()
+{
+  runCase(80, 2 << 20);
+  runCase(400, 2 << 20);
+  runCase(4000, 1 << 20);
+  runCase(20000, 1 << 19);
+}
+
+void benchMarkdownDocument(const SyntheticSiteOptions& options)
+{
+  unsigned seed = options.seed;
+  vector<string> documents;
+  size_t bytes = 0;
+  while (bytes < (8 << 20))
+  {
+    documents.push_back(makeMarkdownDocument(options.maxPostWords, options, seed));
+    bytes += documents.back().length();
+  }
+
+  size_t outputBytes = 0;
+  double seconds = benchSeconds([&]()
+  {
+    for (const string& document : documents)
+      outputBytes += markdownToHtml(document).length();
+  });
+
+  printf("markdownToHtml          %8.2f MB/s  %8.0f documents/s\n",
+      bytes / seconds / 1e6, documents.size() / seconds);
+
+  // Same documents with temporaries taken from a render arena, reset after each one
+  RenderArena arena;
+  ArenaStats totals;
+  double arenaSeconds = benchSeconds([&]()
+  {
+    for (const string& document : documents)
+    {
+      outputBytes += markdownToHtml(document, &arena).length();
+      totals.numAllocations += arena.stats.numAllocations;
+      totals.numHeapAllocations += arena.stats.numHeapAllocations;
+      arena.reset();
+    }
+  });
+
+  printf("markdownToHtml, arena   %8.2f MB/s  %8.0f documents/s  %6.2f allocations/document  %6.2f from the heap\n",
+      bytes / arenaSeconds / 1e6, documents.size() / arenaSeconds,
+      (double) totals.numAllocations / documents.size(), (double) totals.numHeapAllocations / documents.size());
+}
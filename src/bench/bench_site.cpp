@@ -0,0 +1,46 @@
+// Full build benchmarks
+//
+// Builds a synthetic site from scratch with one and with all cores, then
+// again incrementally with nothing changed, and from scratch with minified
+// outputs and with gzip siblings.
+
+#include <stdio.h>
+#include "../site.h"
+#include "bench.h"
+
+using namespace std;
+
+static void runBuild(const char* name, filesystem::path& siteDirectory, filesystem::path& outputDirectory,
+    const BuildOptions& options, size_t numPosts)
+{
+  int result = 0;
+  double seconds = benchSeconds([&]()
+  {
+    result = generateSite(siteDirectory, outputDirectory, options);
+  });
+
+  printf("%-23s %8.3f s   %8.0f posts/s%s\n", name, seconds, numPosts / seconds, result ? "   (failed)" : "");
+}
+
+void benchFullBuild(filesystem::path siteDirectory, filesystem::path outputDirectory, size_t numPosts)
+{
+  // Only errors are logged, so build logs don't drown the results
+  BuildOptions options;
+  options.logLevel = LOG_LEVEL_ERROR;
+  options.cacheDirectory = siteDirectory / ".static_cache";
+  runBuild("full build, 1 job", siteDirectory, outputDirectory, options, numPosts);
+
+  options.numJobs = 0;
+  runBuild("full build, all cores", siteDirectory, outputDirectory, options, numPosts);
+
+  options.incremental = true;
+  runBuild("incremental, no change", siteDirectory, outputDirectory, options, numPosts);
+
+  options.incremental = false;
+  options.minify = true;
+  runBuild("full build, minify", siteDirectory, outputDirectory, options, numPosts);
+
+  options.minify = false;
+  options.gzip = true;
+  runBuild("full build, gzip", siteDirectory, outputDirectory, options, numPosts);
+}
@@ -0,0 +1,160 @@
+// Template benchmarks
+//
+// Measures the tokenizer alone, the search for expressions in the literal
+// text of real layouts and compiling plus rendering a page, with includes
+// resolved from a synthetic site template directory.
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdio.h>
+#include "../parser_utils.h"
+#include "../template.h"
+#include "bench.h"
+
+using namespace std;
+
+static const char* templateFragment =
+  "<div class=\"post\">\n"
+  "  {{for p in all_posts orderby_desc date limit 10}}\n"
+  "    <a href=\"{{p.url}}\">{{p.title}}</a> {{p.year}}-{{p.month}}-{{p.day}}\n"
+  "  {{endfor}}\n"
+  "  {{include \"include/level0.html\"}}\n"
+  "</div>\n";
+
+void benchGetToken()
+{
+  string source;
+  while (source.length() < (4 << 20))
+    source += templateFragment;
+
+  size_t numTokens = 0;
+  double seconds = benchSeconds([&]()
+  {
+    ParseContext context;
+    context.fileName = "bench";
+    context.source = source.c_str();
+    context.eof = source.data() + source.length();
+    context.p = source.data();
+
+    while (getToken(context).type != Token::Type::TOKEN_EOF)
+      numTokens++;
+  });
+
+  printf("getToken                %8.2f MB/s  %8.2f M tokens/s\n",
+      source.length() / seconds / 1e6, numTokens / seconds / 1e6);
+}
+
+// The scan the compiler did before, one byte at a time
+static const char* findExpressionStartBytewise(const char* p, const char* end)
+{
+  while (p < end)
+  {
+    if (*p == '{' && (p + 1) < end && *(p + 1) == '{')
+      return p;
+    ++p;
+  }
+  return end;
+}
+
+template<typename F>
+static size_t countExpressions(const vector<string>& sources, F find)
+{
+  size_t count = 0;
+  for (const string& source : sources)
+  {
+    const char* end = source.data() + source.length();
+    for (const char* p = find(source.data(), end); p < end; p = find(p + 2, end))
+      count++;
+  }
+  return count;
+}
+
+void benchTemplateScan(filesystem::path templateDirectory)
+{
+  vector<string> sources;
+  size_t numBytes = 0;
+  std::error_code error;
+  for (auto it = filesystem::recursive_directory_iterator(templateDirectory, error);
+      it != filesystem::recursive_directory_iterator(); it.increment(error))
+  {
+    if (error)
+      break;
+
+    if (!it->is_regular_file() || it->path().extension() != ".html")
+      continue;
+
+    string source;
+    if (readFileToString(it->path().string().c_str(), source))
+    {
+      numBytes += source.length();
+      sources.push_back(std::move(source));
+    }
+  }
+
+  if (numBytes == 0)
+  {
+    printf("template scan            no layouts found in %s\n", templateDirectory.string().c_str());
+    return;
+  }
+
+  // Layouts are small, so they are scanned repeatedly to get measurable times
+  const size_t numPasses = (64 << 20) / numBytes + 1;
+  size_t bytewiseCount = 0;
+  size_t count = 0;
+  double bytewiseSeconds = benchSeconds([&]()
+  {
+    for (size_t i = 0; i < numPasses; i++)
+      bytewiseCount += countExpressions(sources, findExpressionStartBytewise);
+  });
+
+  double seconds = benchSeconds([&]()
+  {
+    for (size_t i = 0; i < numPasses; i++)
+      count += countExpressions(sources, findExpressionStart);
+  });
+
+  double totalBytes = (double) numBytes * numPasses;
+  printf("template scan  %3zu files %8zu bytes   bytewise %8.2f MB/s   memchr %8.2f MB/s %6.1fx  (%zu)%s\n",
+      sources.size(), numBytes, totalBytes / bytewiseSeconds / 1e6, totalBytes / seconds / 1e6,
+      bytewiseSeconds / seconds, count / numPasses, count == bytewiseCount ? "" : "   MISMATCH");
+}
+
+void benchTemplateRender(filesystem::path templateDirectory)
+{
+  unordered_map<string, string> variables;
+  variables["site.name"] = "Synthetic site";
+  variables["site.url"] = "http://localhost/";
+
+  string source;
+  for (int i = 0; i < 200; i++)
+  {
+    source += "<section><h2>{{site.name}}</h2><p>Some literal text between expressions, "
+      "long enough to look like real markup.</p><a href=\"{{site.url}}\">home</a></section>\n";
+    if (i % 50 == 0)
+      source += "{{include \"include/level0.html\"}}\n";
+  }
+
+  const int numRenders = 2000;
+  size_t outputBytes = 0;
+  bool success = true;
+  double seconds = benchSeconds([&]()
+  {
+    string output;
+    for (int i = 0; i < numRenders && success; i++)
+    {
+      output.clear();
+      success = renderTemplateSource(source, templateDirectory, variables, output);
+      outputBytes += output.length();
+    }
+  });
+
+  if (!success)
+  {
+    printf("template render          failed\n");
+    return;
+  }
+
+  printf("template render         %8.2f MB/s  %8.0f pages/s\n",
+      outputBytes / seconds / 1e6, numRenders / seconds);
+}
@@ -0,0 +1,188 @@
+// Synthetic site generator
+//
+// Builds deterministic sites of any size for the benchmarks. The same options
+// and seed always produce the same files, so numbers can be compared between
+// builds of the generator.
+
+#include <stdio.h>
+#include <string>
+#include "synthetic_site.h"
+
+using namespace std;
+
+static unsigned nextRandom(unsigned& seed)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+static size_t randomBetween(size_t min, size_t max, unsigned& seed)
+{
+  return max <= min ? min : min + nextRandom(seed) % (max - min + 1);
+}
+
+static const char* words[] =
+{
+  "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+  "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+  "magna", "aliqua", "enim", "ad", "minim", "veniam", "quis", "nostrud",
+};
+
+static const char* inlineWords[] =
+{
+  "**strong**", "*emphasis*", "__bold__", "~~strike~~", "\\_escaped\\_",
+  "[a link](http://example.com/page.html)", "![an image](assets/image.png)",
+};
+
+static void appendWords(string& text, size_t numWords, int inlinePercent, unsigned& seed)
+{
+  for (size_t i = 0; i < numWords; i++)
+  {
+    if (i > 0)
+      text += ' ';
+
+    if ((int) (nextRandom(seed) % 100) < inlinePercent / 4)
+      text += inlineWords[nextRandom(seed) % (sizeof(inlineWords) / sizeof(inlineWords[0]))];
+    else
+      text += words[nextRandom(seed) % (sizeof(words) / sizeof(words[0]))];
+  }
+}
+
+string makeMarkdownDocument(size_t numWords, const SyntheticSiteOptions& options, unsigned& seed)
+{
+  string markdown;
+  size_t written = 0;
+  while (written < numWords)
+  {
+    size_t blockWords = randomBetween(20, 80, seed);
+    int kind = (int) (nextRandom(seed) % 100);
+
+    if ((kind -= options.headerPercent) < 0)
+    {
+      markdown += string(randomBetween(1, 3, seed), '#') + " ";
+      appendWords(markdown, 4, 0, seed);
+      markdown += "\n\n";
+      written += 4;
+      continue;
+    }
+
+    if ((kind -= options.listPercent) < 0)
+    {
+      for (size_t i = 0; i < 5; i++)
+      {
+        markdown += "* ";
+        appendWords(markdown, blockWords / 5, options.inlinePercent, seed);
+        markdown += '\n';
+      }
+    }
+    else if ((kind -= options.codePercent) < 0)
+    {
+      for (size_t i = 0; i < 6; i++)
+      {
+        markdown += "      ";
+        appendWords(markdown, blockWords / 6, 0, seed);
+        markdown += '\n';
+      }
+    }
+    else if ((kind -= options.quotePercent) < 0)
+    {
+      markdown += "> ";
+      appendWords(markdown, blockWords, options.inlinePercent, seed);
+      markdown += '\n';
+    }
+    else
+    {
+      appendWords(markdown, blockWords, options.inlinePercent, seed);
+      markdown += '\n';
+    }
+
+    markdown += '\n';
+    written += blockWords;
+  }
+  return markdown;
+}
+
+static bool writeFile(const filesystem::path& fileName, const string& content)
+{
+  FILE* file = fopen(fileName.string().c_str(), "wb");
+  if (!file)
+  {
+    printf("Could not write to file %s\n", fileName.string().c_str());
+    return false;
+  }
+
+  bool written = fwrite(content.c_str(), 1, content.length(), file) == content.length();
+  return fclose(file) == 0 && written;
+}
+
+// include/level0.html includes level1.html and so on, down to includeDepth levels
+static string includeChain(size_t depth)
+{
+  return depth ? "{{include \"include/level0.html\"}}\n" : "";
+}
+
+bool generateSyntheticSite(const filesystem::path& root, const SyntheticSiteOptions& options)
+{
+  error_code error;
+  filesystem::remove_all(root, error);
+  filesystem::path templateDirectory = root / "template";
+  filesystem::path postsDirectory = root / "posts";
+  filesystem::create_directories(templateDirectory / "include", error);
+  filesystem::create_directories(templateDirectory / "layout", error);
+  filesystem::create_directories(templateDirectory / "assets", error);
+  filesystem::create_directories(postsDirectory, error);
+
+  bool success = writeFile(root / "site.txt",
+      "site.name = \"Synthetic site\"\n"
+      "site.url = \"http://localhost/\"\n"
+      "site.templates_dir = \"template\"\n"
+      "site.posts_dir = \"posts\"\n");
+
+  for (size_t i = 0; i < options.includeDepth; i++)
+  {
+    string include = "<div class=\"level" + to_string(i) + "\">{{site.name}}</div>\n";
+    if (i + 1 < options.includeDepth)
+      include += "{{include \"include/level" + to_string(i + 1) + ".html\"}}\n";
+    success = writeFile(templateDirectory / "include" / ("level" + to_string(i) + ".html"), include) && success;
+  }
+
+  string index = "<html><head><title>{{site.name}} - {{page.title}}</title></head>\n<body>\n"
+    + includeChain(options.includeDepth);
+  for (size_t i = 0; i < options.loopsPerPage; i++)
+  {
+    index += i % 2 ? "<ul>{{for p in all_posts}}" : "<ul>{{for p in all_posts orderby_desc date}}";
+    index += "<li><a href=\"{{p.url}}\">{{p.title}}</a> {{p.year}}-{{p.month_name}}-{{p.day}}</li>{{endfor}}</ul>\n";
+  }
+  index += "<ul>{{for p in all_pages}}<li><a href=\"{{p.url}}\">{{p.title}}</a></li>{{endfor}}</ul>\n</body></html>\n";
+  success = writeFile(templateDirectory / "index.html", index) && success;
+
+  success = writeFile(templateDirectory / "about.html",
+      "<html><head><title>{{site.name}} - {{page.title}}</title></head>\n<body>\n"
+      + includeChain(options.includeDepth) + "<p>About {{site.name}}</p>\n</body></html>\n") && success;
+
+  success = writeFile(templateDirectory / "layout" / "post.html",
+      "<html><head><title>{{site.name}} - {{post.title}}</title></head>\n<body>\n"
+      + includeChain(options.includeDepth)
+      + "<h2>{{post.title}}</h2><time>{{post.year}}-{{post.month_name}}-{{post.day}}</time>\n"
+        "<article>{{post.body}}</article>\n</body></html>\n") && success;
+
+  success = writeFile(templateDirectory / "assets" / "default.css", "body { margin: 0 auto; max-width: 40em; }\n") && success;
+
+  unsigned seed = options.seed;
+  for (size_t i = 0; i < options.numPosts; i++)
+  {
+    char date[16];
+    snprintf(date, sizeof(date), "%04d%02d%02d", 2000 + (int) (i / 336) % 30, 1 + (int) (i / 28) % 12, 1 + (int) i % 28);
+
+    string markdown;
+    if (i % 10 == 0)
+      markdown = "{{\"Post " + to_string(i) + ", with a title override\"}}\n";
+
+    size_t numWords = randomBetween(options.minPostWords, options.maxPostWords, seed);
+    markdown += makeMarkdownDocument(numWords, options, seed);
+    string fileName = string("post-") + date + "-Post " + to_string(i) + ".md";
+    success = writeFile(postsDirectory / fileName, markdown) && success;
+  }
+
+  return success;
+}
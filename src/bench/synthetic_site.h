@@ -0,0 +1,31 @@
+#ifndef SYNTHETIC_SITE
+#define SYNTHETIC_SITE
+
+#include <filesystem>
+#include <string>
+
+// Shape of a generated site. Percentages are the share of markdown blocks of
+// each kind; whatever is left are plain paragraphs.
+struct SyntheticSiteOptions
+{
+  size_t numPosts = 1000;
+  size_t minPostWords = 200;      // Post lengths are uniformly distributed
+  size_t maxPostWords = 2000;     // between these
+  size_t includeDepth = 3;        // Nested includes on every page and layout
+  size_t loopsPerPage = 2;        // Loops over all posts on the index page
+  int headerPercent = 10;
+  int listPercent = 10;
+  int codePercent = 5;
+  int quotePercent = 5;
+  int inlinePercent = 40;         // Paragraph words with emphasis, links or escapes
+  unsigned seed = 1;
+};
+
+// Returns a pseudo random markdown document of about numWords words
+std::string makeMarkdownDocument(size_t numWords, const SyntheticSiteOptions& options, unsigned& seed);
+
+// Writes a site with a site.txt, template directory and posts under root,
+// replacing whatever was there. Returns false if any file can't be written.
+bool generateSyntheticSite(const std::filesystem::path& root, const SyntheticSiteOptions& options);
+
+#endif  // SYNTHETIC_SITE
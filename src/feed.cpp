@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <stdio.h>
+#include "feed.h"
+#include "markdown.h"
+#include "parser_utils.h"
+#include "site.h"
+#include "trace.h"
+
+FeedOptions getFeedOptions(const Site& site)
+{
+  FeedOptions options;
+  auto get = [&](const char* name) -> std::string
+  {
+    auto it = site.variables.find(name);
+    return it == site.variables.end() ? std::string() : it->second;
+  };
+
+  options.fileName = get("site.feed");
+  options.rss = get("site.feed_format") == "rss";
+  options.content = get("site.feed_content") == "true";
+  std::string numItems = get("site.feed_items");
+  if (!numItems.empty())
+    options.numItems = std::strtoul(numItems.c_str(), nullptr, 10);
+  return options;
+}
+
+std::vector<size_t> getFeedPosts(const std::vector<Post>& postList, size_t numItems)
+{
+  std::vector<size_t> indices(postList.size());
+  for (size_t i = 0; i < indices.size(); i++)
+    indices[i] = i;
+
+  if (numItems == 0 || numItems > indices.size())
+    numItems = indices.size();
+
+  std::partial_sort(indices.begin(), indices.begin() + numItems, indices.end(), [&](size_t a, size_t b)
+  {
+    if (Post::compareByDate(postList[b], postList[a]))
+      return true;
+    return !Post::compareByDate(postList[a], postList[b]) && a < b;
+  });
+
+  indices.resize(numItems);
+  return indices;
+}
+
+void appendXmlEscaped(std::string& out, std::string_view text)
+{
+  for (char c : text)
+  {
+    switch (c)
+    {
+      case '&':  out += "&amp;"; break;
+      case '<':  out += "&lt;"; break;
+      case '>':  out += "&gt;"; break;
+      case '"':  out += "&quot;"; break;
+      case '\'': out += "&apos;"; break;
+      default:   out += c; break;
+    }
+  }
+}
+
+// Appends site.url followed by the percent encoded relative url
+void appendAbsoluteUrl(std::string& out, std::string_view siteUrl, std::string_view relativeUrl)
+{
+  static const char* HEX_DIGITS = "0123456789ABCDEF";
+  appendXmlEscaped(out, siteUrl);
+  if (!siteUrl.ends_with('/'))
+    out += '/';
+
+  for (char c : relativeUrl)
+  {
+    if (isalnum((unsigned char) c) || c == '/' || c == '-' || c == '.' || c == '_' || c == '~')
+    {
+      out += c;
+      continue;
+    }
+
+    out += '%';
+    out += HEX_DIGITS[((unsigned char) c) >> 4];
+    out += HEX_DIGITS[((unsigned char) c) & 15];
+  }
+}
+
+// RFC 822 date, as used by RSS
+void appendRssDate(std::string& out, const Post& post)
+{
+  static const char* DAY_NAMES[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+  static const char* MONTH_NAMES[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+  std::chrono::year_month_day date{std::chrono::year(post.yearInt), std::chrono::month(post.monthInt), std::chrono::day(post.dayInt)};
+  if (!date.ok())
+    date = std::chrono::year_month_day{std::chrono::year(1970), std::chrono::January, std::chrono::day(1)};
+
+  unsigned weekDay = std::chrono::weekday(std::chrono::sys_days(date)).c_encoding();
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%s, %02u %s %04d 00:00:00 +0000", DAY_NAMES[weekDay],
+      (unsigned) date.day(), MONTH_NAMES[(unsigned) date.month() - 1], (int) date.year());
+  out += buffer;
+}
+
+void appendAtomDate(std::string& out, const Post& post)
+{
+  out.append(post.year).append("-").append(post.month).append("-").append(post.day).append("T00:00:00Z");
+}
+
+// Post html for the feed. Bodies not captured while rendering, because the
+// post was not rendered again, come from the watch mode cache or are converted.
+std::shared_ptr<const std::string> getFeedPostBody(Site& site, const Post& post)
+{
+  {
+    std::lock_guard<std::mutex> lock(site.markdownCacheMutex);
+    auto it = site.markdownCache.find(post.sourceFileName);
+    if (it != site.markdownCache.end())
+      return it->second;
+  }
+
+  FileBuffer source;
+  if (!source.open(post.sourceFileName.c_str()))
+    return nullptr;
+
+  size_t bodyOffset = std::min(post.sourceStartOffset, source.size());
+  return std::make_shared<const std::string>(markdownToHtml(source.view().substr(bodyOffset)));
+}
+
+void writeFeed(Site& site, const FeedOptions& options, const std::vector<size_t>& feedPosts,
+    std::vector<std::shared_ptr<const std::string>>& postBodies, std::string& out)
+{
+  TraceSpan span("feed", options.fileName);
+  const std::string& siteUrl = site.variables["site.url"];
+  const std::string& siteName = site.variables["site.name"];
+
+  out += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+  if (options.rss)
+  {
+    out += "<rss version=\"2.0\">\n<channel>\n<title>";
+    appendXmlEscaped(out, siteName);
+    out += "</title>\n<link>";
+    appendXmlEscaped(out, siteUrl);
+    out += "</link>\n<description>";
+    appendXmlEscaped(out, siteName);
+    out += "</description>\n";
+  }
+  else
+  {
+    out += "<feed xmlns=\"http://www.w3.org/2005/Atom\">\n<title>";
+    appendXmlEscaped(out, siteName);
+    out += "</title>\n<link href=\"";
+    appendXmlEscaped(out, siteUrl);
+    out += "\"/>\n<link rel=\"self\" href=\"";
+    appendAbsoluteUrl(out, siteUrl, options.fileName);
+    out += "\"/>\n<id>";
+    appendXmlEscaped(out, siteUrl);
+    out += "</id>\n<updated>";
+    if (feedPosts.empty())
+      out += "1970-01-01T00:00:00Z";
+    else
+      appendAtomDate(out, site.postList[feedPosts[0]]);
+    out += "</updated>\n";
+
+    // Atom requires an author, for the feed or for every entry
+    const std::string& author = site.variables["site.author"];
+    out += "<author><name>";
+    appendXmlEscaped(out, author.empty() ? siteName : author);
+    out += "</name></author>\n";
+  }
+
+  for (size_t index : feedPosts)
+  {
+    const Post& post = site.postList[index];
+    std::shared_ptr<const std::string> body;
+    if (options.content)
+    {
+      body = postBodies[index] ? postBodies[index] : getFeedPostBody(site, post);
+      postBodies[index] = nullptr;
+    }
+
+    if (options.rss)
+    {
+      out += "<item>\n<title>";
+      appendXmlEscaped(out, post.title);
+      out += "</title>\n<link>";
+      appendAbsoluteUrl(out, siteUrl, post.relativeUrl);
+      out += "</link>\n<guid>";
+      appendAbsoluteUrl(out, siteUrl, post.relativeUrl);
+      out += "</guid>\n<pubDate>";
+      appendRssDate(out, post);
+      out += "</pubDate>\n";
+      if (body)
+      {
+        out += "<description>";
+        appendXmlEscaped(out, *body);
+        out += "</description>\n";
+      }
+      out += "</item>\n";
+    }
+    else
+    {
+      out += "<entry>\n<title>";
+      appendXmlEscaped(out, post.title);
+      out += "</title>\n<link href=\"";
+      appendAbsoluteUrl(out, siteUrl, post.relativeUrl);
+      out += "\"/>\n<id>";
+      appendAbsoluteUrl(out, siteUrl, post.relativeUrl);
+      out += "</id>\n<updated>";
+      appendAtomDate(out, post);
+      out += "</updated>\n";
+      if (body)
+      {
+        out += "<content type=\"html\">";
+        appendXmlEscaped(out, *body);
+        out += "</content>\n";
+      }
+      out += "</entry>\n";
+    }
+  }
+
+  out += options.rss ? "</channel>\n</rss>\n" : "</feed>\n";
+}
+
+void writeSitemaps(Site& site, const std::string& fileName, const OutputManifest& manifest, std::vector<RenderOutput>& outputs)
+{
+  TraceSpan span("sitemap", fileName);
+  const std::string& siteUrl = site.variables["site.url"];
+  std::filesystem::path sitemapPath(fileName);
+  std::string stem = (sitemapPath.parent_path() / sitemapPath.stem()).generic_string();
+  std::string extension = sitemapPath.extension().string();
+
+  size_t firstSitemap = outputs.size();
+  size_t numUrls = 0;
+  auto addUrl = [&](const std::string& relativeUrl, const Post* post)
+  {
+    if (numUrls++ % SITEMAP_MAX_URLS == 0)
+    {
+      if (outputs.size() > firstSitemap)
+        outputs.back().content += "</urlset>\n";
+
+      RenderOutput& sitemap = outputs.emplace_back();
+      sitemap.relativeUrl = stem + "-" + std::to_string(outputs.size() - firstSitemap) + extension;
+      sitemap.content += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+        "<urlset xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\">\n";
+    }
+
+    std::string& out = outputs.back().content;
+    out += "<url><loc>";
+    appendAbsoluteUrl(out, siteUrl, relativeUrl);
+    out += "</loc>";
+    if (post)
+    {
+      out += "<lastmod>";
+      out.append(post->year).append("-").append(post->month).append("-").append(post->day);
+      out += "</lastmod>";
+    }
+    out += "</url>\n";
+  };
+
+  for (const Page& page : site.pageList)
+  {
+    addUrl(page.relativeUrl, nullptr);
+    for (size_t i = 1; ; i++)
+    {
+      std::string paginationUrl = getPaginationUrl(page.relativeUrl, i);
+      if (manifest.find(paginationUrl) == manifest.end())
+        break;
+      addUrl(paginationUrl, nullptr);
+    }
+  }
+
+  for (const Post& post : site.postList)
+    addUrl(post.relativeUrl, &post);
+
+  if (outputs.size() == firstSitemap)
+  {
+    RenderOutput& sitemap = outputs.emplace_back();
+    sitemap.content += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      "<urlset xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\">\n";
+  }
+  outputs.back().content += "</urlset>\n";
+
+  // A single sitemap goes straight to fileName, more are listed by an index on it
+  size_t numSitemaps = outputs.size() - firstSitemap;
+  if (numSitemaps == 1)
+  {
+    outputs.back().relativeUrl = fileName;
+    return;
+  }
+
+  RenderOutput& index = outputs.emplace_back();
+  index.relativeUrl = fileName;
+  index.content += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<sitemapindex xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\">\n";
+  for (size_t i = firstSitemap; i < firstSitemap + numSitemaps; i++)
+  {
+    index.content += "<sitemap><loc>";
+    appendAbsoluteUrl(index.content, siteUrl, outputs[i].relativeUrl);
+    index.content += "</loc></sitemap>\n";
+  }
+  index.content += "</sitemapindex>\n";
+}
@@ -0,0 +1,54 @@
+#ifndef FEED
+#define FEED
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "manifest.h"
+#include "page.h"
+
+struct Site;
+
+// Feeds and sitemaps
+//
+// The feed and the sitemap are written straight from the page and post
+// metadata after every render, in a single pass over the collections and
+// without going through templates. They are enabled from site.txt:
+//
+//   site.feed = "feed.xml"        Atom feed of the newest posts
+//   site.feed_format = "rss"      RSS 2.0 instead of Atom
+//   site.feed_items = "20"        Posts on the feed. 0 includes all of them.
+//   site.feed_content = "true"    Include the post html on every item
+//   site.author = "name"          Atom feed author, defaults to site.name
+//   site.sitemap = "sitemap.xml"  Sitemap of every page and post
+//
+// Urls are made absolute with site.url. Sitemaps with more than 50000 urls
+// are split in numbered files listed by a sitemap index.
+
+const size_t SITEMAP_MAX_URLS = 50000;
+const size_t DEFAULT_FEED_ITEMS = 20;
+
+struct FeedOptions
+{
+  std::string fileName;       // relative to the output directory, empty when disabled
+  bool rss = false;
+  bool content = false;
+  size_t numItems = DEFAULT_FEED_ITEMS;
+};
+
+FeedOptions getFeedOptions(const Site& site);
+
+// Indices of the posts on the feed, newest first. Posts of the same day keep
+// their collection order, so the feed doesn't change between builds.
+std::vector<size_t> getFeedPosts(const std::vector<Post>& postList, size_t numItems);
+
+// Writes the feed to out. Post bodies captured while rendering are taken from
+// postBodies, the others are looked up or converted again.
+void writeFeed(Site& site, const FeedOptions& options, const std::vector<size_t>& feedPosts,
+    std::vector<std::shared_ptr<const std::string>>& postBodies, std::string& out);
+
+// Appends the sitemap files to outputs. Pagination pages are found on the
+// manifest of the build, so pages that were not rendered again are included.
+void writeSitemaps(Site& site, const std::string& fileName, const OutputManifest& manifest, std::vector<RenderOutput>& outputs);
+
+#endif  // FEED
@@ -0,0 +1,621 @@
+#include <algorithm>
+#include <vector>
+#include "gzip.h"
+
+// DEFLATE constants
+const int MIN_MATCH = 3;
+const int MAX_MATCH = 258;
+const size_t WINDOW_SIZE = 32768;
+const size_t WINDOW_MASK = WINDOW_SIZE - 1;
+const int HASH_BITS = 15;
+const size_t HASH_SIZE = (size_t) 1 << HASH_BITS;
+const int MAX_CHAIN = 128;      // candidates tried per position
+const int NICE_MATCH = 128;     // stop searching once a match is this long
+const int LAZY_MATCH = 32;      // don't look for a better match after one this long
+const size_t MAX_BLOCK_SYMBOLS = 16384;
+const size_t MAX_STORED_SIZE = 65535;
+
+const int NUM_LITLEN_CODES = 286;
+const int NUM_DIST_CODES = 30;
+const int NUM_CODELEN_CODES = 19;
+const int END_OF_BLOCK = 256;
+
+static const uint16_t LENGTH_BASE[29] =
+{
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t LENGTH_EXTRA[29] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t DIST_BASE[30] =
+{
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+  1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t DIST_EXTRA[30] =
+{
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static const uint8_t CODELEN_ORDER[NUM_CODELEN_CODES] =
+{
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Code of every match length and distance, looked up instead of searched
+struct CodeTables
+{
+  uint8_t lengthCode[MAX_MATCH + 1];
+  uint8_t distCode[512];   // distances up to 256 by distance - 1, longer ones by 256 + ((distance - 1) >> 7)
+  uint32_t crc[256];
+
+  CodeTables()
+  {
+    for (int code = 0; code < 29; code++)
+    {
+      for (int length = LENGTH_BASE[code]; length < LENGTH_BASE[code] + (1 << LENGTH_EXTRA[code]) && length <= MAX_MATCH; length++)
+        lengthCode[length] = (uint8_t) code;
+    }
+    lengthCode[MAX_MATCH] = 28;
+
+    for (int code = 0; code < NUM_DIST_CODES; code++)
+    {
+      for (int distance = DIST_BASE[code]; distance < DIST_BASE[code] + (1 << DIST_EXTRA[code]); distance++)
+      {
+        if (distance <= 256)
+          distCode[distance - 1] = (uint8_t) code;
+        else
+          distCode[256 + ((distance - 1) >> 7)] = (uint8_t) code;
+      }
+    }
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      crc[i] = c;
+    }
+  }
+
+  int getDistCode(size_t distance) const
+  {
+    return distance <= 256 ? distCode[distance - 1] : distCode[256 + ((distance - 1) >> 7)];
+  }
+};
+
+static const CodeTables codeTables;
+
+uint32_t crc32(const char* buffer, size_t size, uint32_t crc)
+{
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++)
+    crc = codeTables.crc[(crc ^ (unsigned char) buffer[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+// Bits are packed starting from the least significant bit of each byte
+struct BitWriter
+{
+  std::string& out;
+  uint64_t bits = 0;
+  int numBits = 0;
+
+  void put(uint32_t value, int count)
+  {
+    bits |= (uint64_t) value << numBits;
+    numBits += count;
+    while (numBits >= 8)
+    {
+      out += (char) (bits & 0xff);
+      bits >>= 8;
+      numBits -= 8;
+    }
+  }
+
+  void alignToByte()
+  {
+    if (numBits > 0)
+      put(0, 8 - numBits);
+  }
+};
+
+// A literal when distance is 0, a match otherwise
+struct Symbol
+{
+  uint16_t literalOrLength;
+  uint16_t distance;
+};
+
+// Huffman code lengths for the given frequencies, no longer than maxBits.
+// Frequencies are halved until the tree fits, which keeps the code complete.
+static void buildCodeLengths(const uint32_t* frequencies, int numSymbols, int maxBits, uint8_t* lengths)
+{
+  std::vector<uint32_t> scaled(frequencies, frequencies + numSymbols);
+  struct Node
+  {
+    uint32_t frequency;
+    int parent;
+  };
+
+  while (true)
+  {
+    std::fill(lengths, lengths + numSymbols, 0);
+    std::vector<int> leaves;
+    for (int i = 0; i < numSymbols; i++)
+    {
+      if (scaled[i])
+        leaves.push_back(i);
+    }
+
+    if (leaves.empty())
+      return;
+
+    if (leaves.size() == 1)
+    {
+      lengths[leaves[0]] = 1;
+      return;
+    }
+
+    std::stable_sort(leaves.begin(), leaves.end(), [&](int a, int b) { return scaled[a] < scaled[b]; });
+
+    // Leaves come first on the node list, internal nodes follow in creation
+    // order. Both runs are sorted by frequency, so the two smallest nodes
+    // are always at the front of one of them.
+    std::vector<Node> nodes;
+    for (int symbol : leaves)
+      nodes.push_back({scaled[symbol], -1});
+
+    size_t numLeaves = leaves.size();
+    size_t nextLeaf = 0;
+    size_t nextInternal = numLeaves;
+    auto takeSmallest = [&]() -> size_t
+    {
+      if (nextLeaf < numLeaves && (nextInternal >= nodes.size() || nodes[nextLeaf].frequency <= nodes[nextInternal].frequency))
+        return nextLeaf++;
+      return nextInternal++;
+    };
+
+    while (nodes.size() < 2 * numLeaves - 1)
+    {
+      size_t a = takeSmallest();
+      size_t b = takeSmallest();
+      nodes.push_back({nodes[a].frequency + nodes[b].frequency, -1});
+      nodes[a].parent = (int) nodes.size() - 1;
+      nodes[b].parent = (int) nodes.size() - 1;
+    }
+
+    // Parents are created after their children, so depths are filled root first
+    std::vector<int> depths(nodes.size(), 0);
+    for (size_t i = nodes.size() - 1; i-- > 0; )
+      depths[i] = depths[nodes[i].parent] + 1;
+
+    int maxDepth = 0;
+    for (size_t i = 0; i < numLeaves; i++)
+    {
+      lengths[leaves[i]] = (uint8_t) depths[i];
+      maxDepth = std::max(maxDepth, depths[i]);
+    }
+
+    if (maxDepth <= maxBits)
+      return;
+
+    for (uint32_t& frequency : scaled)
+    {
+      if (frequency)
+        frequency = (frequency + 1) / 2;
+    }
+  }
+}
+
+// Canonical codes for the given lengths, bit reversed to be written LSB first
+static void buildCodes(const uint8_t* lengths, int numSymbols, uint16_t* codes)
+{
+  int lengthCount[16] = {};
+  for (int i = 0; i < numSymbols; i++)
+    lengthCount[lengths[i]]++;
+  lengthCount[0] = 0;
+
+  int nextCode[16] = {};
+  int code = 0;
+  for (int bits = 1; bits < 16; bits++)
+  {
+    code = (code + lengthCount[bits - 1]) << 1;
+    nextCode[bits] = code;
+  }
+
+  for (int i = 0; i < numSymbols; i++)
+  {
+    int length = lengths[i];
+    if (!length)
+      continue;
+
+    int value = nextCode[length]++;
+    int reversed = 0;
+    for (int bit = 0; bit < length; bit++)
+      reversed |= ((value >> bit) & 1) << (length - 1 - bit);
+    codes[i] = (uint16_t) reversed;
+  }
+}
+
+// An entry of the run length encoded code lengths of a dynamic block header
+struct CodeLengthSymbol
+{
+  uint8_t symbol;
+  uint8_t extra;
+};
+
+static void encodeCodeLengths(const uint8_t* lengths, int count, std::vector<CodeLengthSymbol>& encoded)
+{
+  int i = 0;
+  while (i < count)
+  {
+    uint8_t length = lengths[i];
+    int run = 1;
+    while (i + run < count && lengths[i + run] == length)
+      run++;
+
+    if (length == 0)
+    {
+      int remaining = run;
+      while (remaining >= 11)
+      {
+        int n = std::min(remaining, 138);
+        encoded.push_back({18, (uint8_t) (n - 11)});
+        remaining -= n;
+      }
+      if (remaining >= 3)
+      {
+        encoded.push_back({17, (uint8_t) (remaining - 3)});
+        remaining = 0;
+      }
+      while (remaining-- > 0)
+        encoded.push_back({0, 0});
+    }
+    else
+    {
+      encoded.push_back({length, 0});
+      int remaining = run - 1;
+      while (remaining >= 3)
+      {
+        int n = std::min(remaining, 6);
+        encoded.push_back({16, (uint8_t) (n - 3)});
+        remaining -= n;
+      }
+      while (remaining-- > 0)
+        encoded.push_back({length, 0});
+    }
+
+    i += run;
+  }
+}
+
+static int getCodeLengthExtraBits(int symbol)
+{
+  return symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0;
+}
+
+static void writeSymbols(BitWriter& writer, const std::vector<Symbol>& symbols,
+    const uint16_t* litLenCodes, const uint8_t* litLenLengths, const uint16_t* distCodes, const uint8_t* distLengths)
+{
+  for (const Symbol& symbol : symbols)
+  {
+    if (symbol.distance == 0)
+    {
+      writer.put(litLenCodes[symbol.literalOrLength], litLenLengths[symbol.literalOrLength]);
+      continue;
+    }
+
+    int lengthCode = codeTables.lengthCode[symbol.literalOrLength];
+    writer.put(litLenCodes[257 + lengthCode], litLenLengths[257 + lengthCode]);
+    writer.put(symbol.literalOrLength - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+    int distCode = codeTables.getDistCode(symbol.distance);
+    writer.put(distCodes[distCode], distLengths[distCode]);
+    writer.put(symbol.distance - DIST_BASE[distCode], DIST_EXTRA[distCode]);
+  }
+
+  writer.put(litLenCodes[END_OF_BLOCK], litLenLengths[END_OF_BLOCK]);
+}
+
+// Writes the symbols of data[blockStart, blockEnd) as a single block, using
+// whichever encoding takes the fewest bits
+static void writeBlock(BitWriter& writer, const std::vector<Symbol>& symbols,
+    std::string_view data, size_t blockStart, size_t blockEnd, bool isFinal)
+{
+  uint32_t litLenFrequencies[NUM_LITLEN_CODES] = {};
+  uint32_t distFrequencies[NUM_DIST_CODES] = {};
+  uint64_t extraBits = 0;
+  for (const Symbol& symbol : symbols)
+  {
+    if (symbol.distance == 0)
+    {
+      litLenFrequencies[symbol.literalOrLength]++;
+      continue;
+    }
+
+    int lengthCode = codeTables.lengthCode[symbol.literalOrLength];
+    int distCode = codeTables.getDistCode(symbol.distance);
+    litLenFrequencies[257 + lengthCode]++;
+    distFrequencies[distCode]++;
+    extraBits += LENGTH_EXTRA[lengthCode] + DIST_EXTRA[distCode];
+  }
+  litLenFrequencies[END_OF_BLOCK]++;
+
+  // Fixed codes
+  uint8_t fixedLitLenLengths[288];
+  uint8_t fixedDistLengths[NUM_DIST_CODES];
+  std::fill(fixedLitLenLengths, fixedLitLenLengths + 144, 8);
+  std::fill(fixedLitLenLengths + 144, fixedLitLenLengths + 256, 9);
+  std::fill(fixedLitLenLengths + 256, fixedLitLenLengths + 280, 7);
+  std::fill(fixedLitLenLengths + 280, fixedLitLenLengths + 288, 8);
+  std::fill(fixedDistLengths, fixedDistLengths + NUM_DIST_CODES, 5);
+
+  // Dynamic codes. Inflaters reject a code with a single symbol of the code
+  // length alphabet, so every alphabet gets at least two symbols.
+  if (std::count_if(distFrequencies, distFrequencies + NUM_DIST_CODES, [](uint32_t f) { return f != 0; }) < 2)
+  {
+    distFrequencies[0] = std::max(distFrequencies[0], 1u);
+    distFrequencies[1] = std::max(distFrequencies[1], 1u);
+  }
+  if (std::count_if(litLenFrequencies, litLenFrequencies + NUM_LITLEN_CODES, [](uint32_t f) { return f != 0; }) < 2)
+    litLenFrequencies[0] = std::max(litLenFrequencies[0], 1u);
+
+  uint8_t litLenLengths[NUM_LITLEN_CODES];
+  uint8_t distLengths[NUM_DIST_CODES];
+  buildCodeLengths(litLenFrequencies, NUM_LITLEN_CODES, 15, litLenLengths);
+  buildCodeLengths(distFrequencies, NUM_DIST_CODES, 15, distLengths);
+
+  int numLitLenCodes = NUM_LITLEN_CODES;
+  while (numLitLenCodes > 257 && litLenLengths[numLitLenCodes - 1] == 0)
+    numLitLenCodes--;
+  int numDistCodes = NUM_DIST_CODES;
+  while (numDistCodes > 1 && distLengths[numDistCodes - 1] == 0)
+    numDistCodes--;
+
+  uint8_t allLengths[NUM_LITLEN_CODES + NUM_DIST_CODES];
+  std::copy(litLenLengths, litLenLengths + numLitLenCodes, allLengths);
+  std::copy(distLengths, distLengths + numDistCodes, allLengths + numLitLenCodes);
+  std::vector<CodeLengthSymbol> encodedLengths;
+  encodeCodeLengths(allLengths, numLitLenCodes + numDistCodes, encodedLengths);
+
+  uint32_t codeLengthFrequencies[NUM_CODELEN_CODES] = {};
+  for (const CodeLengthSymbol& entry : encodedLengths)
+    codeLengthFrequencies[entry.symbol]++;
+  if (std::count_if(codeLengthFrequencies, codeLengthFrequencies + NUM_CODELEN_CODES, [](uint32_t f) { return f != 0; }) < 2)
+    codeLengthFrequencies[codeLengthFrequencies[0] ? 1 : 0] = 1;
+
+  uint8_t codeLengthLengths[NUM_CODELEN_CODES];
+  buildCodeLengths(codeLengthFrequencies, NUM_CODELEN_CODES, 7, codeLengthLengths);
+
+  int numCodeLengthCodes = NUM_CODELEN_CODES;
+  while (numCodeLengthCodes > 4 && codeLengthLengths[CODELEN_ORDER[numCodeLengthCodes - 1]] == 0)
+    numCodeLengthCodes--;
+
+  // Sizes of the three encodings, in bits
+  uint64_t fixedBits = 3 + extraBits;
+  uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * (uint64_t) numCodeLengthCodes + extraBits;
+  for (int i = 0; i < NUM_LITLEN_CODES; i++)
+  {
+    fixedBits += (uint64_t) litLenFrequencies[i] * fixedLitLenLengths[i];
+    dynamicBits += (uint64_t) litLenFrequencies[i] * litLenLengths[i];
+  }
+  for (int i = 0; i < NUM_DIST_CODES; i++)
+  {
+    fixedBits += (uint64_t) distFrequencies[i] * fixedDistLengths[i];
+    dynamicBits += (uint64_t) distFrequencies[i] * distLengths[i];
+  }
+  for (const CodeLengthSymbol& entry : encodedLengths)
+    dynamicBits += codeLengthLengths[entry.symbol] + getCodeLengthExtraBits(entry.symbol);
+
+  size_t blockSize = blockEnd - blockStart;
+  size_t numStoredChunks = std::max((size_t) 1, (blockSize + MAX_STORED_SIZE - 1) / MAX_STORED_SIZE);
+  uint64_t storedBits = numStoredChunks * (3 + 7 + 32) + (uint64_t) blockSize * 8;
+
+  if (storedBits < fixedBits && storedBits < dynamicBits)
+  {
+    size_t p = blockStart;
+    for (size_t chunk = 0; chunk < numStoredChunks; chunk++)
+    {
+      size_t length = std::min(MAX_STORED_SIZE, blockEnd - p);
+      writer.put((isFinal && chunk + 1 == numStoredChunks) ? 1 : 0, 1);
+      writer.put(0, 2);
+      writer.alignToByte();
+      writer.put((uint32_t) length, 16);
+      writer.put((uint32_t) (~length & 0xffff), 16);
+      writer.out.append(data.data() + p, length);
+      p += length;
+    }
+    return;
+  }
+
+  writer.put(isFinal ? 1 : 0, 1);
+  uint16_t litLenCodes[288] = {};
+  uint16_t distCodes[NUM_DIST_CODES] = {};
+  if (fixedBits <= dynamicBits)
+  {
+    writer.put(1, 2);
+    buildCodes(fixedLitLenLengths, 288, litLenCodes);
+    buildCodes(fixedDistLengths, NUM_DIST_CODES, distCodes);
+    writeSymbols(writer, symbols, litLenCodes, fixedLitLenLengths, distCodes, fixedDistLengths);
+    return;
+  }
+
+  writer.put(2, 2);
+  writer.put(numLitLenCodes - 257, 5);
+  writer.put(numDistCodes - 1, 5);
+  writer.put(numCodeLengthCodes - 4, 4);
+  for (int i = 0; i < numCodeLengthCodes; i++)
+    writer.put(codeLengthLengths[CODELEN_ORDER[i]], 3);
+
+  uint16_t codeLengthCodes[NUM_CODELEN_CODES] = {};
+  buildCodes(codeLengthLengths, NUM_CODELEN_CODES, codeLengthCodes);
+  for (const CodeLengthSymbol& entry : encodedLengths)
+  {
+    writer.put(codeLengthCodes[entry.symbol], codeLengthLengths[entry.symbol]);
+    writer.put(entry.extra, getCodeLengthExtraBits(entry.symbol));
+  }
+
+  buildCodes(litLenLengths, NUM_LITLEN_CODES, litLenCodes);
+  buildCodes(distLengths, NUM_DIST_CODES, distCodes);
+  writeSymbols(writer, symbols, litLenCodes, litLenLengths, distCodes, distLengths);
+}
+
+// Hash chains over the last WINDOW_SIZE positions. Positions are stored plus
+// one, so 0 ends a chain. Only head needs clearing between inputs: prev is
+// always written for a position before its chain is walked.
+struct MatchFinder
+{
+  std::string_view data;
+  std::vector<uint32_t> head = std::vector<uint32_t>(HASH_SIZE, 0);
+  std::vector<uint32_t> prev = std::vector<uint32_t>(WINDOW_SIZE, 0);
+
+  void reset(std::string_view input)
+  {
+    data = input;
+    std::fill(head.begin(), head.end(), 0);
+  }
+
+  uint32_t hash(size_t p) const
+  {
+    const unsigned char* s = (const unsigned char*) data.data() + p;
+    uint32_t value = s[0] | (s[1] << 8) | (s[2] << 16);
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+  }
+
+  void insert(size_t p)
+  {
+    if (p + MIN_MATCH > data.length())
+      return;
+
+    uint32_t h = hash(p);
+    prev[p & WINDOW_MASK] = head[h];
+    head[h] = (uint32_t) p + 1;
+  }
+
+  // Returns the length of the longest match for p, 0 if there is none, and
+  // inserts p in the chains
+  int findAndInsert(size_t p, size_t& distance)
+  {
+    if (p + MIN_MATCH > data.length())
+      return 0;
+
+    const char* s = data.data();
+    int maxLength = (int) std::min((size_t) MAX_MATCH, data.length() - p);
+    int bestLength = 0;
+    uint32_t candidate = head[hash(p)];
+    for (int chain = 0; candidate && chain < MAX_CHAIN; chain++)
+    {
+      size_t c = candidate - 1;
+      if (c >= p || p - c > WINDOW_SIZE)
+        break;
+
+      if (s[c + bestLength] == s[p + bestLength] && s[c] == s[p])
+      {
+        int length = 0;
+        while (length < maxLength && s[c + length] == s[p + length])
+          length++;
+
+        if (length > bestLength)
+        {
+          bestLength = length;
+          distance = p - c;
+          if (length >= NICE_MATCH || length == maxLength)
+            break;
+        }
+      }
+
+      uint32_t next = prev[c & WINDOW_MASK];
+      if (next >= candidate)
+        break;
+      candidate = next;
+    }
+
+    insert(p);
+    return bestLength >= MIN_MATCH ? bestLength : 0;
+  }
+};
+
+static void deflate(std::string_view data, std::string& out)
+{
+  // Most outputs are a few kilobytes, so the chains and symbol buffer are
+  // kept per thread instead of allocated for every file
+  thread_local MatchFinder finder;
+  thread_local std::vector<Symbol> symbols;
+  finder.reset(data);
+  symbols.clear();
+  symbols.reserve(MAX_BLOCK_SYMBOLS + 2);
+
+  BitWriter writer = {out};
+  size_t blockStart = 0;
+  const size_t size = data.length();
+
+  size_t p = 0;
+  size_t distance = 0;
+  int length = size ? finder.findAndInsert(0, distance) : 0;
+  while (p < size)
+  {
+    if (length)
+    {
+      // Lazy matching: a longer match starting on the next byte wins over this one
+      size_t inserted = p;
+      if (length < LAZY_MATCH && p + 1 < size)
+      {
+        size_t nextDistance = 0;
+        int nextLength = finder.findAndInsert(p + 1, nextDistance);
+        inserted = p + 1;
+        if (nextLength > length)
+        {
+          symbols.push_back({(uint8_t) data[p], 0});
+          p++;
+          length = nextLength;
+          distance = nextDistance;
+          continue;
+        }
+      }
+
+      symbols.push_back({(uint16_t) length, (uint16_t) distance});
+      for (size_t i = inserted + 1; i < p + length; i++)
+        finder.insert(i);
+      p += length;
+    }
+    else
+    {
+      symbols.push_back({(uint8_t) data[p], 0});
+      p++;
+    }
+
+    if (symbols.size() >= MAX_BLOCK_SYMBOLS)
+    {
+      writeBlock(writer, symbols, data, blockStart, p, p == size);
+      symbols.clear();
+      blockStart = p;
+    }
+
+    length = p < size ? finder.findAndInsert(p, distance) : 0;
+  }
+
+  if (blockStart < size || size == 0)
+    writeBlock(writer, symbols, data, blockStart, size, true);
+  writer.alignToByte();
+}
+
+void gzipCompress(std::string_view data, std::string& out)
+{
+  // Header: magic, deflate, no flags, no time stamp, no extra flags, unknown OS
+  static const unsigned char header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+  out.append((const char*) header, sizeof(header));
+
+  deflate(data, out);
+
+  uint32_t crc = crc32(data.data(), data.length());
+  uint32_t size = (uint32_t) data.length();
+  for (int i = 0; i < 4; i++)
+    out += (char) ((crc >> (8 * i)) & 0xff);
+  for (int i = 0; i < 4; i++)
+    out += (char) ((size >> (8 * i)) & 0xff);
+}
@@ -0,0 +1,22 @@
+#ifndef GZIP
+#define GZIP
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+// Gzip encoder
+//
+// A self contained DEFLATE (RFC 1951) encoder wrapped in the gzip (RFC 1952)
+// format, so outputs can be served precompressed without any dependency.
+// Matches are found with hash chains and lazy matching, and every block is
+// written with dynamic Huffman codes, the fixed codes or stored, whichever
+// is smaller. The header has no file name and no time stamp, so the same
+// input always gives the same bytes.
+
+// Appends the gzip encoding of data to out
+void gzipCompress(std::string_view data, std::string& out);
+
+uint32_t crc32(const char* buffer, size_t size, uint32_t crc = 0);
+
+#endif  // GZIP
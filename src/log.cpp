@@ -0,0 +1,182 @@
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <stdarg.h>
+#include <stdio.h>
+#include "log.h"
+
+// A run of formatted lines handed over by one thread
+struct LogChunk
+{
+  LogChunk* next;
+  std::string text;
+};
+
+// Threads push chunks onto a lock free stack, newest first. The sink takes
+// the whole stack at once and writes it oldest first, so the lines of each
+// thread keep their order.
+static std::atomic<int> logLevel = LOG_LEVEL_INFO;
+static std::atomic<LogChunk*> pendingChunks = nullptr;
+static std::atomic<uint64_t> numChunksPushed = 0;
+static std::atomic<uint64_t> numChunksWritten = 0;
+static std::atomic<uint32_t> sinkWakeups = 0;
+static std::atomic<bool> sinkStopping = false;
+
+static const size_t LOG_CHUNK_SIZE = 16 * 1024;
+
+static void runSink()
+{
+  uint32_t wakeups = 0;
+  while (true)
+  {
+    sinkWakeups.wait(wakeups, std::memory_order_acquire);
+    wakeups = sinkWakeups.load(std::memory_order_acquire);
+
+    LogChunk* chunk = pendingChunks.exchange(nullptr, std::memory_order_acquire);
+    LogChunk* oldest = nullptr;
+    while (chunk)
+    {
+      LogChunk* next = chunk->next;
+      chunk->next = oldest;
+      oldest = chunk;
+      chunk = next;
+    }
+
+    uint64_t numWritten = 0;
+    while (oldest)
+    {
+      LogChunk* next = oldest->next;
+      fwrite(oldest->text.data(), 1, oldest->text.size(), stdout);
+      delete oldest;
+      oldest = next;
+      numWritten++;
+    }
+
+    if (numWritten)
+    {
+      fflush(stdout);
+      numChunksWritten.fetch_add(numWritten, std::memory_order_release);
+      numChunksWritten.notify_all();
+    }
+
+    if (sinkStopping.load(std::memory_order_acquire) && !pendingChunks.load(std::memory_order_acquire))
+      break;
+  }
+}
+
+// Started on the first chunk and stopped after everything else is gone, at exit
+struct LogSink
+{
+  std::once_flag started;
+  std::thread thread;
+
+  ~LogSink()
+  {
+    if (!thread.joinable())
+      return;
+
+    sinkStopping.store(true, std::memory_order_release);
+    sinkWakeups.fetch_add(1, std::memory_order_release);
+    sinkWakeups.notify_one();
+    thread.join();
+  }
+};
+
+static LogSink logSink;
+
+static void pushChunk(std::string& buffer)
+{
+  if (buffer.empty())
+    return;
+
+  LogChunk* chunk = new LogChunk{nullptr, std::move(buffer)};
+  buffer = std::string();
+  buffer.reserve(LOG_CHUNK_SIZE);
+
+  chunk->next = pendingChunks.load(std::memory_order_relaxed);
+  while (!pendingChunks.compare_exchange_weak(chunk->next, chunk, std::memory_order_release, std::memory_order_relaxed))
+    ;
+
+  std::call_once(logSink.started, []() { logSink.thread = std::thread(runSink); });
+  numChunksPushed.fetch_add(1, std::memory_order_release);
+  sinkWakeups.fetch_add(1, std::memory_order_release);
+  sinkWakeups.notify_one();
+}
+
+// Whatever is left is handed over when the thread exits
+struct ThreadLog
+{
+  std::string buffer;
+
+  ~ThreadLog()
+  {
+    pushChunk(buffer);
+  }
+};
+
+static ThreadLog& getThreadLog()
+{
+  thread_local ThreadLog threadLog;
+  return threadLog;
+}
+
+void setLogLevel(LogLevel level)
+{
+  logLevel.store(level, std::memory_order_relaxed);
+}
+
+LogLevel getLogLevel()
+{
+  return (LogLevel) logLevel.load(std::memory_order_relaxed);
+}
+
+void logMessage(LogLevel level, const char* fmt, ...)
+{
+  if (level > logLevel.load(std::memory_order_relaxed))
+    return;
+
+  std::string& buffer = getThreadLog().buffer;
+  if (buffer.capacity() < LOG_CHUNK_SIZE)
+    buffer.reserve(LOG_CHUNK_SIZE);
+
+  // Most messages fit in what is left of the buffer. Longer ones are
+  // formatted again once their length is known.
+  va_list args;
+  va_start(args, fmt);
+  va_list argsCopy;
+  va_copy(argsCopy, args);
+
+  size_t offset = buffer.size();
+  size_t available = buffer.capacity() - offset;
+  buffer.resize(buffer.capacity());
+  int length = vsnprintf(buffer.data() + offset, available + 1, fmt, args);
+  if (length < 0)
+    length = 0;
+
+  if ((size_t) length > available)
+  {
+    buffer.resize(offset + length);
+    vsnprintf(buffer.data() + offset, length + 1, fmt, argsCopy);
+  }
+  buffer.resize(offset + length);
+
+  va_end(argsCopy);
+  va_end(args);
+
+  if (level == LOG_LEVEL_ERROR || buffer.size() >= LOG_CHUNK_SIZE)
+    pushChunk(buffer);
+}
+
+void flushLog()
+{
+  pushChunk(getThreadLog().buffer);
+
+  uint64_t target = numChunksPushed.load(std::memory_order_acquire);
+  uint64_t written = numChunksWritten.load(std::memory_order_acquire);
+  while (written < target)
+  {
+    numChunksWritten.wait(written, std::memory_order_acquire);
+    written = numChunksWritten.load(std::memory_order_acquire);
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef LOG
+#define LOG
+
+// Logging
+//
+// Messages are formatted into a buffer owned by the calling thread and
+// handed to a background sink thread in chunks, so logging never blocks on
+// the console and lines of different threads never interleave. Errors are
+// handed over right away; everything else waits until the buffer fills up,
+// the thread exits or flushLog() is called. Messages above the current
+// level cost a single atomic load.
+
+enum LogLevel
+{
+  LOG_LEVEL_ERROR   = 0,  // --quiet
+  LOG_LEVEL_INFO    = 1,  // default
+  LOG_LEVEL_VERBOSE = 2,  // --verbose, one line per file
+};
+
+#define logError(msg) logMessage(LOG_LEVEL_ERROR, "ERROR\t- " msg)
+#define logErrorFmt(fmt, ...) logMessage(LOG_LEVEL_ERROR, "ERROR\t- " fmt, __VA_ARGS__)
+#define logInfoFmt(fmt, ...) logMessage(LOG_LEVEL_INFO, "INFO\t- " fmt, __VA_ARGS__)
+#define logInfo(msg) logMessage(LOG_LEVEL_INFO, "INFO\t- " msg)
+#define logVerboseFmt(fmt, ...) logMessage(LOG_LEVEL_VERBOSE, "INFO\t- " fmt, __VA_ARGS__)
+#define logVerbose(msg) logMessage(LOG_LEVEL_VERBOSE, "INFO\t- " msg)
+
+#ifdef __GNUC__
+#define LOG_PRINTF_FORMAT(fmtIndex, argsIndex) __attribute__((format(printf, fmtIndex, argsIndex)))
+#else
+#define LOG_PRINTF_FORMAT(fmtIndex, argsIndex)
+#endif
+
+void setLogLevel(LogLevel level);
+
+LogLevel getLogLevel();
+
+void logMessage(LogLevel level, const char* fmt, ...) LOG_PRINTF_FORMAT(2, 3);
+
+// Hands the calling thread's buffer to the sink and waits until everything
+// logged so far, by any thread, is written to stdout.
+void flushLog();
+
+#endif  // LOG
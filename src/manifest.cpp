@@ -0,0 +1,561 @@
+#include <algorithm>
+#include <cstdlib>
+#include <stdio.h>
+#include "manifest.h"
+#include "gzip.h"
+#include "parallel.h"
+#include "parser_utils.h"
+#include "trace.h"
+
+// Source discovery
+//
+// Posts may be sharded into sub directories, so the posts directory is walked
+// recursively, each top level sub directory on its own job. Matching files
+// are gathered on flat vectors and sorted once. The listing of every
+// directory is cached along with its modification time, which changes
+// whenever an entry is added, removed or renamed, so directories that did not
+// change are not read again on incremental builds and watch mode rebuilds.
+// Incremental builds keep the listings in the cache directory.
+
+const char* SCAN_CACHE_FILE_NAME = "scan_cache";
+
+int64_t getLastWriteTime(const std::filesystem::path& path)
+{
+  std::error_code error;
+  auto lastWriteTime = std::filesystem::last_write_time(path, error);
+  return error ? 0 : (int64_t) lastWriteTime.time_since_epoch().count();
+}
+
+// Lists the files with the given extension directly inside path, sorted.
+bool scanDirectory(const std::filesystem::path& path, const char* extension, std::vector<std::filesystem::path>& files)
+{
+  if (!std::filesystem::exists(path))
+  {
+    logErrorFmt("Path does not exist: %s\n", path.string().c_str());
+    return false;
+  }
+
+  files.clear();
+  for(auto& p : std::filesystem::directory_iterator(path))
+  {
+    if (p.path().extension().compare(extension) == 0)
+      files.push_back(p.path());
+  }
+
+  std::sort(files.begin(), files.end());
+  return !files.empty();
+}
+
+// Appends the files with the given extension inside path and its sub
+// directories, reusing the listing of directories that did not change since
+// previousCache was made. Every directory listing is appended to scanned.
+// Directories named assets hold post assets, not posts.
+void scanDirectoryTree(const std::filesystem::path& path,
+    const char* extension,
+    const ScanCache& previousCache,
+    std::vector<std::filesystem::path>& files,
+    std::vector<std::pair<std::string, ScannedDirectory>>& scanned,
+    bool recursive = true)
+{
+  std::string key = path.string();
+  int64_t lastWriteTime = getLastWriteTime(path);
+  ScannedDirectory directory;
+
+  auto it = previousCache.find(key);
+  if (it != previousCache.end() && lastWriteTime != 0 && it->second.lastWriteTime == lastWriteTime)
+  {
+    directory = it->second;
+  }
+  else
+  {
+    directory.lastWriteTime = lastWriteTime;
+    std::error_code error;
+    for (auto& entry : std::filesystem::directory_iterator(path, error))
+    {
+      std::error_code entryError;
+      std::string name = entry.path().filename().string();
+      if (entry.is_directory(entryError))
+      {
+        if (name != "assets")
+          directory.directories.push_back(std::move(name));
+      }
+      else if (entry.path().extension().compare(extension) == 0)
+      {
+        directory.files.push_back(std::move(name));
+      }
+    }
+  }
+
+  for (const std::string& name : directory.files)
+    files.push_back(path / name);
+
+  if (recursive)
+  {
+    for (const std::string& name : directory.directories)
+      scanDirectoryTree(path / name, extension, previousCache, files, scanned);
+  }
+
+  scanned.emplace_back(std::move(key), std::move(directory));
+}
+
+bool scanDirectoryRecursive(const std::filesystem::path& path,
+    const char* extension,
+    int numJobs,
+    ScanCache& cache,
+    std::vector<std::filesystem::path>& files)
+{
+  if (!std::filesystem::exists(path))
+  {
+    logErrorFmt("Path does not exist: %s\n", path.string().c_str());
+    return false;
+  }
+
+  files.clear();
+  std::vector<std::pair<std::string, ScannedDirectory>> scanned;
+  scanDirectoryTree(path, extension, cache, files, scanned, false);
+
+  // Walk each top level sub directory on its own job
+  const std::vector<std::string>& subdirectories = scanned.back().second.directories;
+  std::vector<std::vector<std::filesystem::path>> subdirectoryFiles(subdirectories.size());
+  std::vector<std::vector<std::pair<std::string, ScannedDirectory>>> subdirectoryScans(subdirectories.size());
+  parallelFor(subdirectories.size(), numJobs, [&](size_t i)
+  {
+    scanDirectoryTree(path / subdirectories[i], extension, cache,
+        subdirectoryFiles[i], subdirectoryScans[i]);
+  });
+
+  ScanCache newCache;
+  for (size_t i = 0; i < subdirectories.size(); i++)
+  {
+    files.insert(files.end(), std::make_move_iterator(subdirectoryFiles[i].begin()),
+        std::make_move_iterator(subdirectoryFiles[i].end()));
+    for (auto& it : subdirectoryScans[i])
+      newCache.insert(std::move(it));
+  }
+  for (auto& it : scanned)
+    newCache.insert(std::move(it));
+
+  cache = std::move(newCache);
+  std::sort(files.begin(), files.end());
+  return !files.empty();
+}
+
+// Cache lines are "D <modification time> <directory path>" followed by one
+// "F <name>" line per matching file and one "S <name>" line per sub directory
+bool loadScanCache(const std::filesystem::path& cacheDirectory, ScanCache& cache)
+{
+  std::string fileName = (cacheDirectory / SCAN_CACHE_FILE_NAME).string();
+  if (!std::filesystem::exists(fileName))
+    return false;
+
+  FileBuffer file;
+  if (!file.open(fileName.c_str()))
+    return false;
+
+  std::string_view content = file.view();
+  ScannedDirectory* directory = nullptr;
+  size_t p = 0;
+  while (p < content.length())
+  {
+    size_t eol = content.find('\n', p);
+    if (eol == std::string_view::npos)
+      eol = content.length();
+
+    std::string_view line = content.substr(p, eol - p);
+    p = eol + 1;
+    if (line.length() < 3 || line[1] != ' ')
+      continue;
+
+    if (line[0] == 'D')
+    {
+      const char* start = line.data() + 2;
+      char* end;
+      int64_t lastWriteTime = std::strtoll(start, &end, 10);
+      if (end >= line.data() + line.length() || *end != ' ')
+      {
+        directory = nullptr;
+        continue;
+      }
+
+      std::string path(end + 1, line.data() + line.length() - end - 1);
+      directory = &cache[path];
+      directory->lastWriteTime = lastWriteTime;
+    }
+    else if (directory && line[0] == 'F')
+    {
+      directory->files.emplace_back(line.substr(2));
+    }
+    else if (directory && line[0] == 'S')
+    {
+      directory->directories.emplace_back(line.substr(2));
+    }
+  }
+
+  return true;
+}
+
+bool saveScanCache(const std::filesystem::path& cacheDirectory, const ScanCache& cache)
+{
+  std::error_code error;
+  std::filesystem::create_directories(cacheDirectory, error);
+
+  std::string fileName = (cacheDirectory / SCAN_CACHE_FILE_NAME).string();
+  FILE* file = fopen(fileName.c_str(), "wb");
+  if (!file)
+  {
+    logErrorFmt("Could not write to file %s\n", fileName.c_str());
+    return false;
+  }
+
+  for (auto& it : cache)
+  {
+    fprintf(file, "D %lld %s\n", (long long) it.second.lastWriteTime, it.first.c_str());
+    for (const std::string& name : it.second.files)
+      fprintf(file, "F %s\n", name.c_str());
+    for (const std::string& name : it.second.directories)
+      fprintf(file, "S %s\n", name.c_str());
+  }
+
+  fclose(file);
+  return true;
+}
+
+// Output manifest
+//
+// Incremental builds store the hash and size of each generated file in the
+// cache directory, and compare rendered content against it so only files
+// whose bytes actually changed are written, and outputs whose sources are
+// gone can be removed without wiping the whole output directory. The cache
+// directory is kept out of the output directory, so build state is never
+// published with the site.
+
+const char* MANIFEST_FILE_NAME = "output_manifest";
+
+// Manifest lines are "<hash> <size> <relative path>"
+bool loadOutputManifest(const std::filesystem::path& cacheDirectory, OutputManifest& manifest)
+{
+  std::string fileName = (cacheDirectory / MANIFEST_FILE_NAME).string();
+  if (!std::filesystem::exists(fileName))
+    return false;
+
+  FileBuffer file;
+  if (!file.open(fileName.c_str()))
+    return false;
+
+  const char* p = file.data();
+  const char* eof = p + file.size();
+  while (p < eof)
+  {
+    const char* eol = std::find(p, eof, '\n');
+    char* end;
+    ManifestEntry entry;
+    entry.hash = std::strtoull(p, &end, 16);
+    entry.size = (size_t) std::strtoull(end, &end, 10);
+
+    if (end < eol && *end == ' ')
+      manifest[std::string(end + 1, eol - end - 1)] = entry;
+
+    p = eol + 1;
+  }
+
+  return true;
+}
+
+bool saveOutputManifest(const std::filesystem::path& cacheDirectory, const OutputManifest& manifest)
+{
+  std::error_code error;
+  std::filesystem::create_directories(cacheDirectory, error);
+
+  std::string fileName = (cacheDirectory / MANIFEST_FILE_NAME).string();
+  FILE* file = fopen(fileName.c_str(), "wb");
+  if (!file)
+  {
+    logErrorFmt("Could not write to file %s\n", fileName.c_str());
+    return false;
+  }
+
+  for (auto& it : manifest)
+  {
+    fprintf(file, "%016llx %zu %s\n", (unsigned long long) it.second.hash, it.second.size, it.first.c_str());
+  }
+
+  fclose(file);
+  return true;
+}
+
+// Writes content with a single unbuffered write to a temporary file that is
+// then renamed over the output, so readers never see a half-written file.
+bool writeFileAtomically(const std::string& fileName, const std::string& content)
+{
+  std::string tempFileName = fileName + ".tmp";
+  FILE* file = fopen(tempFileName.c_str(), "wb");
+  if (!file)
+    return false;
+
+  setvbuf(file, nullptr, _IONBF, 0);
+  bool written = fwrite(content.c_str(), 1, content.length(), file) == content.length();
+  written = fclose(file) == 0 && written;
+
+  std::error_code error;
+  if (written)
+    std::filesystem::rename(tempFileName, fileName, error);
+
+  if (!written || error)
+  {
+    std::filesystem::remove(tempFileName, error);
+    return false;
+  }
+
+  return true;
+}
+
+// Gzip siblings
+//
+// With --gzip, text outputs and assets get a precompressed .gz sibling for
+// servers that serve those directly. The sibling is compressed by the job
+// that synced the file, so compression runs in parallel, and only when the
+// file changed or the sibling is missing or older than it.
+
+const char* GZIP_EXTENSIONS[] = {".html", ".htm", ".css", ".js", ".xml", ".svg", ".txt", ".json"};
+
+bool isGzipCandidate(const std::string& fileName)
+{
+  for (const char* extension : GZIP_EXTENSIONS)
+  {
+    if (fileName.ends_with(extension))
+      return true;
+  }
+  return false;
+}
+
+bool syncGzipSibling(const std::string& fileName, const std::string* content, bool changed, SizeStats* stats)
+{
+  if (!isGzipCandidate(fileName))
+    return true;
+
+  std::string gzipFileName = fileName + ".gz";
+  std::error_code error;
+  if (!stats)
+  {
+    if (changed)
+      std::filesystem::remove(gzipFileName, error);
+    return true;
+  }
+
+  if (!changed)
+  {
+    auto gzipTime = std::filesystem::last_write_time(gzipFileName, error);
+    if (!error && gzipTime >= std::filesystem::last_write_time(fileName, error) && !error)
+      return true;
+  }
+
+  TraceSpan span("gzip", fileName);
+  FileBuffer file;
+  std::string_view data;
+  if (content)
+    data = *content;
+  else if (file.open(fileName.c_str()))
+    data = file.view();
+  else
+    return false;
+
+  std::string compressed;
+  compressed.reserve(data.size() / 4 + 64);
+  gzipCompress(data, compressed);
+  if (!writeFileAtomically(gzipFileName, compressed))
+  {
+    logErrorFmt("Could not write to file %s\n", gzipFileName.c_str());
+    return false;
+  }
+
+  stats->numFiles.fetch_add(1, std::memory_order_relaxed);
+  stats->inputBytes.fetch_add(data.size(), std::memory_order_relaxed);
+  stats->outputBytes.fetch_add(compressed.size(), std::memory_order_relaxed);
+  return true;
+}
+
+WriteResult writeOutputFile(
+    const std::string& outputFileName,
+    const std::string& content,
+    const ManifestEntry* previousEntry,
+    ManifestEntry& entry,
+    SizeStats* gzip)
+{
+  TraceSpan span("write", outputFileName);
+  entry.hash = hashBuffer(content.c_str(), content.length());
+  entry.size = content.length();
+
+  WriteResult result = WRITE_WRITTEN;
+  if (previousEntry && previousEntry->hash == entry.hash && previousEntry->size == entry.size)
+  {
+    std::error_code error;
+    if (std::filesystem::file_size(outputFileName, error) == entry.size && !error)
+      result = WRITE_UNCHANGED;
+  }
+
+  if (result == WRITE_WRITTEN && !writeFileAtomically(outputFileName, content))
+  {
+    logErrorFmt("Could not write to file %s\n", outputFileName.c_str());
+    return WRITE_FAILED;
+  }
+
+  if (!syncGzipSibling(outputFileName, &content, result == WRITE_WRITTEN, gzip))
+    return WRITE_FAILED;
+
+  return result;
+}
+
+// Post index
+//
+// Collecting posts needs each post title override, which means opening the
+// post. The index keeps the modification time, size, title override and body
+// offset of every post, so posts whose stat still matches are not opened
+// while collecting. Incremental builds keep it in the cache directory.
+
+const char* POST_INDEX_FILE_NAME = "post_index";
+
+bool getFileInfo(const std::string& fileName, int64_t& lastWriteTime, uintmax_t& size)
+{
+  std::error_code error;
+  size = std::filesystem::file_size(fileName, error);
+  if (error)
+    return false;
+
+  lastWriteTime = getLastWriteTime(fileName);
+  return lastWriteTime != 0;
+}
+
+// Index lines are "<modification time> <size> <body offset> <path>\t<title>"
+bool loadPostIndex(const std::filesystem::path& cacheDirectory, PostIndex& index)
+{
+  std::string fileName = (cacheDirectory / POST_INDEX_FILE_NAME).string();
+  if (!std::filesystem::exists(fileName))
+    return false;
+
+  FileBuffer file;
+  if (!file.open(fileName.c_str()))
+    return false;
+
+  std::string_view content = file.view();
+  size_t p = 0;
+  while (p < content.length())
+  {
+    size_t eol = content.find('\n', p);
+    if (eol == std::string_view::npos)
+      eol = content.length();
+
+    const char* line = content.data() + p;
+    const char* lineEnd = content.data() + eol;
+    p = eol + 1;
+
+    char* end;
+    PostIndexEntry entry;
+    entry.lastWriteTime = std::strtoll(line, &end, 10);
+    entry.size = std::strtoull(end, &end, 10);
+    entry.sourceStartOffset = std::strtoull(end, &end, 10);
+    const char* tab = std::find((const char*) end, lineEnd, '\t');
+    if (end >= lineEnd || *end != ' ' || tab == lineEnd)
+      continue;
+
+    entry.title.assign(tab + 1, lineEnd);
+    index[std::string((const char*) end + 1, tab)] = std::move(entry);
+  }
+
+  return true;
+}
+
+bool savePostIndex(const std::filesystem::path& cacheDirectory, const PostIndex& index)
+{
+  std::error_code error;
+  std::filesystem::create_directories(cacheDirectory, error);
+
+  std::string fileName = (cacheDirectory / POST_INDEX_FILE_NAME).string();
+  FILE* file = fopen(fileName.c_str(), "wb");
+  if (!file)
+  {
+    logErrorFmt("Could not write to file %s\n", fileName.c_str());
+    return false;
+  }
+
+  for (auto& it : index)
+  {
+    const PostIndexEntry& entry = it.second;
+    fprintf(file, "%lld %llu %zu %s\t%s\n", (long long) entry.lastWriteTime,
+        (unsigned long long) entry.size, entry.sourceStartOffset, it.first.c_str(), entry.title.c_str());
+  }
+
+  fclose(file);
+  return true;
+}
+
+// Asset index
+//
+// Fingerprinted asset names need the hash of each asset. The index keeps it
+// by modification time and size, so incremental builds only read the assets
+// that changed. Incremental builds keep it in the cache directory.
+
+const char* ASSET_INDEX_FILE_NAME = "asset_index";
+
+// Index lines are "<hash> <modification time> <size> <path>"
+bool loadAssetIndex(const std::filesystem::path& cacheDirectory, AssetIndex& index)
+{
+  std::string fileName = (cacheDirectory / ASSET_INDEX_FILE_NAME).string();
+  if (!std::filesystem::exists(fileName))
+    return false;
+
+  FileBuffer file;
+  if (!file.open(fileName.c_str()))
+    return false;
+
+  const char* p = file.data();
+  const char* eof = p + file.size();
+  while (p < eof)
+  {
+    const char* eol = std::find(p, eof, '\n');
+    char* end;
+    AssetIndexEntry entry;
+    entry.hash = std::strtoull(p, &end, 16);
+    entry.lastWriteTime = std::strtoll(end, &end, 10);
+    entry.size = std::strtoull(end, &end, 10);
+
+    if (end < eol && *end == ' ')
+      index[std::string(end + 1, eol - end - 1)] = entry;
+
+    p = eol + 1;
+  }
+
+  return true;
+}
+
+bool saveAssetIndex(const std::filesystem::path& cacheDirectory, const AssetIndex& index)
+{
+  std::error_code error;
+  std::filesystem::create_directories(cacheDirectory, error);
+
+  std::string fileName = (cacheDirectory / ASSET_INDEX_FILE_NAME).string();
+  FILE* file = fopen(fileName.c_str(), "wb");
+  if (!file)
+  {
+    logErrorFmt("Could not write to file %s\n", fileName.c_str());
+    return false;
+  }
+
+  for (auto& it : index)
+  {
+    const AssetIndexEntry& entry = it.second;
+    fprintf(file, "%016llx %lld %llu %s\n", (unsigned long long) entry.hash, (long long) entry.lastWriteTime,
+        (unsigned long long) entry.size, it.first.c_str());
+  }
+
+  fclose(file);
+  return true;
+}
+
+void removeBuildState(const std::filesystem::path& cacheDirectory)
+{
+  std::error_code error;
+  std::filesystem::remove(cacheDirectory / SCAN_CACHE_FILE_NAME, error);
+  std::filesystem::remove(cacheDirectory / MANIFEST_FILE_NAME, error);
+  std::filesystem::remove(cacheDirectory / POST_INDEX_FILE_NAME, error);
+  std::filesystem::remove(cacheDirectory / ASSET_INDEX_FILE_NAME, error);
+}
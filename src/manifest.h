@@ -0,0 +1,122 @@
+#ifndef MANIFEST
+#define MANIFEST
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// State kept between builds: directory listings of the sources, the hash of
+// every generated file, the title override of every post and the hash of
+// every fingerprinted asset. Incremental builds keep it in the cache directory.
+
+struct ScannedDirectory
+{
+  int64_t lastWriteTime = 0;
+  std::vector<std::string> files;        // names of the matching files
+  std::vector<std::string> directories;  // names of the sub directories
+};
+
+using ScanCache = std::unordered_map<std::string, ScannedDirectory>;
+
+bool scanDirectory(const std::filesystem::path& path, const char* extension, std::vector<std::filesystem::path>& files);
+
+// Lists the files with the given extension inside path and all its sub
+// directories, sorted, and updates cache with the directory listings.
+bool scanDirectoryRecursive(const std::filesystem::path& path,
+    const char* extension,
+    int numJobs,
+    ScanCache& cache,
+    std::vector<std::filesystem::path>& files);
+
+bool loadScanCache(const std::filesystem::path& cacheDirectory, ScanCache& cache);
+
+bool saveScanCache(const std::filesystem::path& cacheDirectory, const ScanCache& cache);
+
+struct ManifestEntry
+{
+  uint64_t hash = 0;
+  size_t size = 0;
+};
+
+using OutputManifest = std::unordered_map<std::string, ManifestEntry>;
+
+enum WriteResult
+{
+  WRITE_FAILED    = 0,
+  WRITE_UNCHANGED = 1,
+  WRITE_WRITTEN   = 2,
+};
+
+// An output written by a render job besides the page or post output itself
+struct RenderOutput
+{
+  std::string relativeUrl;
+  std::string content;
+  ManifestEntry entry;
+  WriteResult result = WRITE_FAILED;
+};
+
+bool loadOutputManifest(const std::filesystem::path& cacheDirectory, OutputManifest& manifest);
+
+bool saveOutputManifest(const std::filesystem::path& cacheDirectory, const OutputManifest& manifest);
+
+// Files an output stage processed and their sizes before and after it, counted
+// by any number of jobs
+struct SizeStats
+{
+  std::atomic<size_t> numFiles = 0;
+  std::atomic<uintmax_t> inputBytes = 0;
+  std::atomic<uintmax_t> outputBytes = 0;
+};
+
+// Brings the .gz sibling of a file that was just synced up to date. content
+// holds the file contents, or is null to read them back from the file.
+// Without stats gzip is off, and siblings of changed files are removed since
+// they would no longer match.
+bool syncGzipSibling(const std::string& fileName, const std::string* content, bool changed, SizeStats* stats);
+
+// Writes the output file unless the previous build already produced the same
+// content, then syncs its gzip sibling
+WriteResult writeOutputFile(
+    const std::string& outputFileName,
+    const std::string& content,
+    const ManifestEntry* previousEntry,
+    ManifestEntry& entry,
+    SizeStats* gzip);
+
+struct PostIndexEntry
+{
+  int64_t lastWriteTime = 0;
+  uintmax_t size = 0;
+  size_t sourceStartOffset = 0;
+  std::string title;  // Title override, when sourceStartOffset is not 0
+};
+
+using PostIndex = std::unordered_map<std::string, PostIndexEntry>;
+
+bool getFileInfo(const std::string& fileName, int64_t& lastWriteTime, uintmax_t& size);
+
+bool loadPostIndex(const std::filesystem::path& cacheDirectory, PostIndex& index);
+
+bool savePostIndex(const std::filesystem::path& cacheDirectory, const PostIndex& index);
+
+struct AssetIndexEntry
+{
+  int64_t lastWriteTime = 0;
+  uintmax_t size = 0;
+  uint64_t hash = 0;
+};
+
+using AssetIndex = std::unordered_map<std::string, AssetIndexEntry>;  // by source path
+
+bool loadAssetIndex(const std::filesystem::path& cacheDirectory, AssetIndex& index);
+
+bool saveAssetIndex(const std::filesystem::path& cacheDirectory, const AssetIndex& index);
+
+// Deletes the state incremental builds keep in the cache directory
+void removeBuildState(const std::filesystem::path& cacheDirectory);
+
+#endif  // MANIFEST
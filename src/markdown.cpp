@@ -1,114 +1,327 @@
 //TODO(marcio): It's not outputting underscore character on some posts
 //TODO(marcio): Implement lists
 
-#include <iostream>
-#include <fstream>
+#include <algorithm>
+#include <memory_resource>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <cstring>
+#include <vector>
+#include "markdown.h"
 
 using namespace std;
 
-string getSpanLevelFormatting(const string& line);
+// Inline (span level) formatting
+//
+// A single left to right walk over the line handles escape sequences,
+// images, links and strong/em/strike emphasis, appending straight into the
+// output buffer. Emphasis content and link text are formatted recursively
+// over their own range only.
 
-string replaceScapeSequences(string line)
+// Returns the html entity for an escaped character or nullptr if the character can't be escaped
+static const char* getEscapedEntity(char c)
 {
-  size_t pos = line.find("\\");
-  while (pos != string::npos)
+  switch(c)
   {
-    if(line[pos+1] == '_')
-      line.replace(pos, 2, "&#95;");
-    else if(line[pos+1] == '[')
-      line.replace(pos, 2, "&#91;");
-    else if(line[pos+1] == ']')
-      line.replace(pos, 2, "&#93;");
-    else if(line[pos+1] == '<')
-      line.replace(pos, 2, "&lt;");
-    else if(line[pos+1] == '>')
-      line.replace(pos, 2, "&gt;");
-    else if(line[pos+1] == '(')
-      line.replace(pos, 2, "&#10098;");
-    else if(line[pos+1] == ')')
-      line.replace(pos, 2, "&#10099;");
-    else if(line[pos+1] == '\\')
-      line.replace(pos, 2, "&#92;");
-
-    pos = line.find("\\", pos+1);
+    case '_':  return "&#95;";
+    case '[':  return "&#91;";
+    case ']':  return "&#93;";
+    case '<':  return "&lt;";
+    case '>':  return "&gt;";
+    case '(':  return "&#10098;";
+    case ')':  return "&#10099;";
+    case '\\': return "&#92;";
+    default:   return nullptr;
   }
+}
 
-  return line;
+static inline bool isEscaped(const char* p, const char* start)
+{
+  return p > start && *(p - 1) == '\\' && getEscapedEntity(*p);
 }
 
-string getHeader(string line) 
+// Finds the closing emphasis delimiter. Single delimiters skip over double
+// ones, so '*a **b** c*' closes on the last '*'.
+static const char* findEmphasisEnd(const char* start, const char* p, const char* end, char c, int width)
 {
-  int count = 0;
-  while (line[count] == '#')
-    count++;
+  while (p < end)
+  {
+    p = (const char*) memchr(p, c, end - p);
+    if (!p)
+      return nullptr;
+
+    const char* runEnd = p;
+    while (runEnd < end && *runEnd == c)
+      ++runEnd;
 
-  if (count > 5) return getSpanLevelFormatting(line);
+    if (isEscaped(p, start))
+    {
+      p = p + 1;
+      continue;
+    }
+
+    int run = (int) (runEnd - p);
+    if (width == 2 && run >= 2)
+      return p;
+    if (width == 1 && run == 1)
+      return p;
 
-  string countString = to_string(count);
-  return "<h" + countString + ">" + getSpanLevelFormatting(line.substr(count + 1)) + "</h" + countString + ">";
+    p = runEnd;
+  }
+  return nullptr;
 }
 
-string getListItem(string line) 
+// The ']' matching each '[' of the line, found in a single pass with a
+// bracket stack, so nested brackets never make links rescan the line
+const uint32_t NO_LINK_END = UINT32_MAX;
+
+struct LinkBrackets
+{
+  const char* lineStart = nullptr;
+  vector<uint32_t> ends;   // by offset of the '[', NO_LINK_END when it's never closed
+  vector<uint32_t> stack;
+
+  void match(const char* start, const char* end)
+  {
+    lineStart = start;
+    ends.assign(end - start, NO_LINK_END);
+    stack.clear();
+    for (const char* p = start; p < end; ++p)
+    {
+      if (isEscaped(p, start))
+        continue;
+      if (*p == '[')
+        stack.push_back((uint32_t) (p - start));
+      else if (*p == ']' && !stack.empty())
+      {
+        ends[stack.back()] = (uint32_t) (p - start);
+        stack.pop_back();
+      }
+    }
+  }
+};
+
+// Finds the ']' matching the '[' at p, if it's before end
+static const char* findLinkTextEnd(const LinkBrackets& brackets, const char* p, const char* end)
 {
-  return "<li>" + getSpanLevelFormatting(line.substr(3)) + "</li>";
+  uint32_t offset = brackets.ends[p - brackets.lineStart];
+  if (offset == NO_LINK_END || brackets.lineStart + offset >= end)
+    return nullptr;
+  return brackets.lineStart + offset;
 }
 
-string getLink(const string&& line) 
+// Parses the '(url)' part of links and images. Returns the position after ')' or nullptr.
+static const char* parseLinkUrl(const char* start, const char* p, const char* end, string_view& url)
 {
-  smatch match;
+  if (p >= end || *p != '(')
+    return nullptr;
 
-  if(line.find("](") != string::npos)
+  const char* urlStart = ++p;
+  for (; p < end; ++p)
   {
-    static regex pattern("(.*)\\[(.*)\\]\\((.*)\\)(.*)");
-    if (regex_search(line, match, pattern)) 
+    if (*p == ')' && !isEscaped(p, start))
     {
-      return getLink(match[1].str()) + "<a href=\"" + match[3].str() + "\">" + match[2].str() + "</a>" + getLink(match[4].str());
+      url = string_view(urlStart, p - urlStart);
+      return p + 1;
     }
   }
-  return line;
+  return nullptr;
 }
 
-string getImage(const string& line) 
+static void appendInline(string& out, const char* start, const char* end, const LinkBrackets& brackets)
 {
-  smatch match;
+  // Once a search for a closing delimiter or a link url end fails, no later
+  // opener of the same kind can be closed either, so the line is never
+  // rescanned for it.
+  enum { STRONG_STAR, STRONG_UNDERSCORE, EM_STAR, EM_UNDERSCORE, STRIKE, NUM_DELIMITERS };
+  bool noCloser[NUM_DELIMITERS] = {};
+  bool noUrlEnd = false;
 
-  if(line.find("![") != string::npos)
+  const char* p = start;
+  const char* literalStart = p;
+
+  auto flushLiteral = [&](const char* literalEnd)
+  {
+    out.append(literalStart, literalEnd - literalStart);
+  };
+
+  while (p < end)
   {
-    static regex pattern("(.*)!\\[(.*)\\]\\((.*)\\)(.*)");
-    if (regex_search(line, match, pattern)) 
+    char c = *p;
+    if (c != '\\' && c != '!' && c != '[' && c != '*' && c != '_' && c != '~')
+    {
+      ++p;
+      continue;
+    }
+
+    const char* next = p + 1;
+    char nextc = next < end ? *next : 0;
+
+    // Escape sequences
+    if (c == '\\')
     {
-      return match[1].str() + "<img src=\"" + match[3].str() + "\" alt=\"" + match[2].str() + "\">" + match[4].str();
+      const char* entity = nextc ? getEscapedEntity(nextc) : nullptr;
+      if (entity)
+      {
+        flushLiteral(p);
+        out.append(entity);
+        p += 2;
+        literalStart = p;
+        continue;
+      }
+      ++p;
+      continue;
     }
+
+    // Images ![alt](url)
+    if (c == '!' && nextc == '[')
+    {
+      const char* altEnd = findLinkTextEnd(brackets, p + 1, end);
+      string_view url;
+      const char* imageEnd = altEnd && !noUrlEnd ? parseLinkUrl(start, altEnd + 1, end, url) : nullptr;
+      if (altEnd && !imageEnd && altEnd + 1 < end && altEnd[1] == '(')
+        noUrlEnd = true;
+
+      if (imageEnd)
+      {
+        flushLiteral(p);
+        out.append("<img src=\"").append(url).append("\" alt=\"");
+        out.append(p + 2, altEnd - (p + 2));
+        out.append("\">");
+        p = imageEnd;
+        literalStart = p;
+        continue;
+      }
+      ++p;
+      continue;
+    }
+
+    // Links [text](url)
+    if (c == '[')
+    {
+      const char* textEnd = findLinkTextEnd(brackets, p, end);
+      string_view url;
+      const char* linkEnd = textEnd && !noUrlEnd ? parseLinkUrl(start, textEnd + 1, end, url) : nullptr;
+      if (textEnd && !linkEnd && textEnd + 1 < end && textEnd[1] == '(')
+        noUrlEnd = true;
+
+      if (linkEnd)
+      {
+        flushLiteral(p);
+        out.append("<a href=\"").append(url).append("\">");
+        appendInline(out, p + 1, textEnd, brackets);
+        out.append("</a>");
+        p = linkEnd;
+        literalStart = p;
+        continue;
+      }
+      ++p;
+      continue;
+    }
+
+    // Emphasis **strong** __strong__ *em* _em_ ~~strike~~
+    int width = (nextc == c) ? 2 : 1;
+    if (c == '~' && width == 1)
+    {
+      ++p;
+      continue;
+    }
+
+    int delimiter = c == '~' ? STRIKE :
+      c == '*' ? (width == 2 ? STRONG_STAR : EM_STAR) :
+      (width == 2 ? STRONG_UNDERSCORE : EM_UNDERSCORE);
+
+    const char* contentStart = p + width;
+    const char* closer = noCloser[delimiter] ? nullptr : findEmphasisEnd(start, contentStart, end, c, width);
+    if (!closer)
+    {
+      noCloser[delimiter] = true;
+      p += width;
+      continue;
+    }
+
+    const char* tag = c == '~' ? "s" : (width == 2 ? "strong" : "em");
+    flushLiteral(p);
+    out.append("<").append(tag).append(">");
+    appendInline(out, contentStart, closer, brackets);
+    out.append("</").append(tag).append(">");
+    p = closer + width;
+    literalStart = p;
   }
-  return line;
+
+  flushLiteral(p);
 }
 
-string getEmphasis(const string&& line) 
+void appendSpanLevelFormatting(string& out, string_view line)
 {
-  if (line.find_first_of("*_~") != string::npos)
-  {
-    static regex strongPattern("(\\*\\*|__)(.*?)\\1");
-    string result = regex_replace(line, strongPattern, "<strong>$2</strong>");
+  // Kept per thread, so matching brackets doesn't allocate for every line
+  thread_local LinkBrackets brackets;
+  const char* start = line.data();
+  const char* end = start + line.length();
+  if (memchr(start, '[', line.length()))
+    brackets.match(start, end);
+  else
+    brackets.ends.clear();
+
+  appendInline(out, start, end, brackets);
+}
 
-    static regex emPattern("(_|\\*)(.*?)\\1");
-    result = regex_replace(result, emPattern, "<em>$2</em>");
+// Block level elements
+//
+// Blocks are appended straight into the output. The only temporaries are the
+// lines being read, one per nesting level, allocated from the arena given to
+// markdownToHtml.
 
-    static regex strikPattern("(\\~\\~)(.*?)\\1");
-    result = regex_replace(result, strikPattern, "<s>$2</s>");
-    return result;
+static void appendHeader(string& html, string_view line)
+{
+  size_t count = 0;
+  while (count < line.length() && line[count] == '#')
+    count++;
+
+  if (count > 5)
+  {
+    appendSpanLevelFormatting(html, line);
+    return;
   }
 
-  return line;
+  char level = (char) ('0' + count);
+  html.append("<h").append(1, level).append(">");
+  appendSpanLevelFormatting(html, line.substr(min(count + 1, line.length())));
+  html.append("</h").append(1, level).append(">");
 }
 
-string getSpanLevelFormatting(const string& line)
+static void appendListItem(string& html, string_view line)
 {
-  return getEmphasis(replaceScapeSequences(getLink(getImage(line))));
+  html.append("<li>");
+  appendSpanLevelFormatting(html, line.substr(min((size_t) 3, line.length())));
+  html.append("</li>");
 }
 
-void skipIndent(string& line, int maxIndent)
+// Reads lines from a markdown buffer the same way getline() reads them from a stream
+struct LineReader
+{
+  string_view source;
+  size_t pos = 0;
+};
+
+bool getline(LineReader& reader, pmr::string& line)
+{
+  if (reader.pos >= reader.source.length())
+  {
+    line.clear();
+    return false;
+  }
+
+  size_t eol = reader.source.find('\n', reader.pos);
+  if (eol == string_view::npos)
+    eol = reader.source.length();
+
+  line.assign(reader.source.data() + reader.pos, eol - reader.pos);
+  reader.pos = eol + 1;
+  return true;
+}
+
+void skipIndent(pmr::string& line, int maxIndent)
 {
   if (line.empty())
     return;
@@ -135,10 +348,10 @@ void skipIndent(string& line, int maxIndent)
 }
 
 
-string processBlockElements(ifstream& source, int nested = 0)
+void processBlockElements(LineReader& source, string& html, pmr::memory_resource* arena, int nested = 0)
 {
-  string line, html;
-  const string SIX_SPACES("      ");
+  pmr::string line(arena);
+  const string_view SIX_SPACES("      ");
   while (getline(source, line)) 
   {
     if (line.empty()) continue;
@@ -146,7 +359,7 @@ string processBlockElements(ifstream& source, int nested = 0)
 
     if (line[0] == '#')
     {
-      html += getHeader(line);
+      appendHeader(html, line);
     }
     else if (line[0] == '*') 
     {
@@ -154,22 +367,26 @@ string processBlockElements(ifstream& source, int nested = 0)
       do 
       {
         line.erase(0, 1);
-        html += "<li>" + processBlockElements(source, nested++) + "</li>";
+        html += "<li>";
+        processBlockElements(source, html, arena, nested++);
+        html += "</li>";
         getline(source, line);
       }
       while (!line.empty());
       html += "</ul>";
 
       if (nested)
-        return html;
+        return;
     }
     else if (line[0] == '1' && line[1] == '.') 
     {
-      html += "<ol>\n" + getListItem(line) + "</ol>";
+      html += "<ol>\n";
+      appendListItem(html, line);
+      html += "</ol>";
     }
     else if(line.starts_with(SIX_SPACES)) // 6 spaces means code block
     {
-      string paragraph;
+      html += "<pre><code>";
       do
       {
         // It's only required to indent the first line. But if next lines are
@@ -177,15 +394,14 @@ string processBlockElements(ifstream& source, int nested = 0)
         if(line.starts_with(SIX_SPACES))
           line.erase(0, 6);
 
-        paragraph += line + "\n";
+        html.append(line).append("\n");
         getline(source, line);
       }
       while(!line.empty());
-      html += "<pre><code>" + paragraph + "</code></pre>";
+      html += "</code></pre>";
     }
     else if(line[0] == '>')
     {
-      string paragraph;
       int depth = 0;
       int indentCharIndex = 0;
       int lineCount = 0;
@@ -208,12 +424,14 @@ string processBlockElements(ifstream& source, int nested = 0)
         if (newDepth > depth)
         {
           depth = newDepth;
-          paragraph += "<blockquote><p>";
+          html += "<blockquote><p>";
           lineCount = 0;
         }
 
         line.erase(0, indentCharIndex);
-        paragraph += (lineCount++ > 0) ? "<br>" + line : line;
+        if (lineCount++ > 0)
+          html += "<br>";
+        html += line;
         getline(source, line);
       }
       while(!line.empty());
@@ -221,50 +439,32 @@ string processBlockElements(ifstream& source, int nested = 0)
       while(depth)
       {
         depth--;
-        paragraph += "</p></blockquote>";
+        html += "</p></blockquote>";
       }
-
-      html += paragraph;
     }
     else
     {
-      string paragraph;
       int lineCount = 0;
-
+      html += "<p>";
       do
       {
-        paragraph += 
-          lineCount++ ?
-          "<br>" + getSpanLevelFormatting(line):
-          getSpanLevelFormatting(line);
+        if (lineCount++)
+          html += "<br>";
+        appendSpanLevelFormatting(html, line);
 
         getline(source, line);
       }
       while(!line.empty());
-      html += "<p>" + paragraph + "</p>";
+      html += "</p>";
     }
   }
-  return html;
 }
 
-string markdownToHtml(string sourceFile)
+string markdownToHtml(string_view source, pmr::memory_resource* arena)
 {
-  ifstream markdownFile(sourceFile);
-
-  if (markdownFile.is_open()) 
-  {
-    // Skip first line if it is a title override
-    string line;
-    getline(markdownFile, line);
-    line.erase(0, line.find_first_not_of(" \t"));
-    line.erase(line.find_last_not_of(" \t") + 1);
-    if (!(line.starts_with("{{\"") && line.ends_with("\"}}")))
-    {
-      markdownFile.seekg(0);
-    }
-  }
-
-  string html = processBlockElements(markdownFile);
+  LineReader reader = {source, 0};
+  string html;
+  html.reserve(source.length() + source.length() / 4);
+  processBlockElements(reader, html, arena);
   return html;
 }
-
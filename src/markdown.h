@@ -1,9 +1,18 @@
 #ifndef MARKDOWN
 #define MARKDOWN
 
+#include <memory_resource>
 #include <string>
+#include <string_view>
 struct ParseContext;
 
-std::string markdownToHtml(std::string source);
+// Converts a markdown document to html. A title override line must be
+// skipped by the caller. Temporaries are allocated from arena.
+std::string markdownToHtml(std::string_view source,
+    std::pmr::memory_resource* arena = std::pmr::get_default_resource());
+
+// Appends the html for the inline elements (emphasis, links, images and
+// escape sequences) of a single line of markdown.
+void appendSpanLevelFormatting(std::string& out, std::string_view line);
 
 #endif  //MARKDOWN
@@ -0,0 +1,185 @@
+#include <string.h>
+#include "minify.h"
+
+// Elements whose contents are copied untouched
+static const char* RAW_ELEMENTS[] = {"pre", "code", "script", "style", "textarea"};
+
+// Elements the whitespace around is never rendered for: the document
+// structure, elements of the head, which are not rendered at all, and table
+// rows. Whitespace next to other blocks, like li, renders once css makes them
+// inline, so it is only collapsed.
+static const char* BLOCK_ELEMENTS[] =
+{
+  "!doctype", "body", "head", "html", "link", "meta", "script", "style", "table", "tbody", "tfoot",
+  "thead", "title", "tr",
+};
+
+const size_t MAX_TAG_NAME = 16;
+
+static bool isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static bool isTagNameChar(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '!';
+}
+
+static char toLowerAscii(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? (char) (c + ('a' - 'A')) : c;
+}
+
+template<size_t N>
+static bool isOneOf(const char* name, const char* (&names)[N])
+{
+  for (const char* candidate : names)
+  {
+    if (strcmp(name, candidate) == 0)
+      return true;
+  }
+  return false;
+}
+
+static bool startsWith(const char* p, const char* end, const char* prefix)
+{
+  size_t length = strlen(prefix);
+  return (size_t) (end - p) >= length && memcmp(p, prefix, length) == 0;
+}
+
+// Case insensitive search for the closing tag of a raw element. The name
+// must end there, so </code doesn't match </codex>.
+static const char* findClosingTag(const char* p, const char* end, const char* name)
+{
+  size_t length = strlen(name);
+  while ((p = (const char*) memchr(p, '<', end - p)) != nullptr)
+  {
+    if ((size_t) (end - p) >= length + 2 && p[1] == '/')
+    {
+      size_t i = 0;
+      while (i < length && toLowerAscii(p[2 + i]) == name[i])
+        i++;
+
+      const char* nameEnd = p + 2 + length;
+      if (i == length && (nameEnd == end || *nameEnd == '>' || *nameEnd == '/' || isSpace(*nameEnd)))
+        return p;
+    }
+    p++;
+  }
+  return end;
+}
+
+// Copies the tag starting at p, collapsing whitespace between attributes.
+// Returns the position after the tag.
+static const char* copyTag(const char* p, const char* end, std::string& out)
+{
+  char quote = 0;
+  bool pendingSpace = false;
+  while (p < end)
+  {
+    char c = *p++;
+    if (quote)
+    {
+      out += c;
+      if (c == quote)
+        quote = 0;
+      continue;
+    }
+
+    if (isSpace(c))
+    {
+      pendingSpace = true;
+      continue;
+    }
+
+    if (pendingSpace && c != '>')
+      out += ' ';
+    pendingSpace = false;
+    out += c;
+
+    if (c == '"' || c == '\'')
+      quote = c;
+    else if (c == '>')
+      break;
+  }
+  return p;
+}
+
+void minifyHtml(std::string_view html, std::string& out)
+{
+  const char* p = html.data();
+  const char* end = p + html.length();
+  bool pendingSpace = false;
+  bool afterBlock = true;  // Leading whitespace of the document is dropped too
+
+  while (p < end)
+  {
+    char c = *p;
+    if (isSpace(c))
+    {
+      pendingSpace = true;
+      p++;
+      continue;
+    }
+
+    if (c == '<' && startsWith(p, end, "<!--"))
+    {
+      size_t length = std::string_view(p, end - p).find("-->", 4);
+      const char* commentEnd = length == std::string_view::npos ? end : p + length + 3;
+
+      // Conditional comments are markup for old browsers
+      if (startsWith(p + 4, end, "[") || startsWith(p + 4, end, "<!"))
+      {
+        if (pendingSpace && !afterBlock)
+          out += ' ';
+        pendingSpace = false;
+        afterBlock = false;
+        out.append(p, commentEnd - p);
+      }
+      p = commentEnd;
+      continue;
+    }
+
+    bool closing = c == '<' && p + 1 < end && p[1] == '/';
+    const char* nameStart = p + (closing ? 2 : 1);
+    char first = nameStart < end ? toLowerAscii(*nameStart) : 0;
+    if (c == '<' && ((first >= 'a' && first <= 'z') || (first == '!' && !closing)))
+    {
+      char name[MAX_TAG_NAME + 1];
+      size_t length = 0;
+      for (const char* n = nameStart; n < end && isTagNameChar(*n) && length < MAX_TAG_NAME; n++)
+        name[length++] = toLowerAscii(*n);
+      name[length] = 0;
+
+      bool block = isOneOf(name, BLOCK_ELEMENTS);
+      if (pendingSpace && !afterBlock && !block)
+        out += ' ';
+      pendingSpace = false;
+      afterBlock = block;
+
+      size_t tagStart = out.length();
+      p = copyTag(p, end, out);
+
+      bool selfClosing = out.length() - tagStart >= 2 && out[out.length() - 2] == '/';
+      if (!closing && !selfClosing && isOneOf(name, RAW_ELEMENTS))
+      {
+        const char* contentEnd = findClosingTag(p, end, name);
+        out.append(p, contentEnd - p);
+        p = contentEnd;
+      }
+      continue;
+    }
+
+    // Text, up to the next whitespace or tag
+    if (pendingSpace && !afterBlock)
+      out += ' ';
+    pendingSpace = false;
+    afterBlock = false;
+
+    const char* textStart = p++;
+    while (p < end && *p != '<' && !isSpace(*p))
+      p++;
+    out.append(textStart, p - textStart);
+  }
+}
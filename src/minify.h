@@ -0,0 +1,20 @@
+#ifndef MINIFY
+#define MINIFY
+
+#include <string>
+#include <string_view>
+
+// Html minifier
+//
+// A single forward pass over rendered html that drops comments and collapses
+// whitespace runs to one space, or removes them where they never render: at
+// the start and end of the document and next to the html, head, body, head
+// elements and table row tags. Whitespace
+// inside tags is collapsed outside quoted attribute values. The contents of
+// pre, code, script, style and textarea elements and conditional comments are
+// copied untouched.
+
+// Appends the minified html to out
+void minifyHtml(std::string_view html, std::string& out);
+
+#endif  // MINIFY
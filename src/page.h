@@ -0,0 +1,181 @@
+#ifndef PAGE
+#define PAGE
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "parser_utils.h"
+
+template<typename T>
+using CompareFunction = bool(*)(const T&, const T&);
+
+// Compare functions always compare in ascending order. Descending order is
+// obtained by swapping the arguments, so no shared state is needed to sort.
+template<typename T>
+struct SortingInformation
+{
+  bool ascending = true;
+  CompareFunction<T> compareFunction = nullptr;
+  SortingInformation(CompareFunction<T> f, bool ascending = true):ascending(ascending), compareFunction(f) {}
+
+  bool operator()(const T& a, const T& b) const
+  {
+    return ascending ? compareFunction(a, b) : compareFunction(b, a);
+  }
+};
+
+// site structure
+struct Page
+{
+  std::string title;
+  std::string relativeUrl;
+  std::string sourceFileName;
+  std::string outputFileName;
+  size_t sourceStartOffset;
+
+  Page(std::string& title,
+      std::string& relativeUrl,
+      std::string& sourceFileName,
+      std::string& outFileName,
+      size_t sourceStartOffset):
+    title(title),
+    relativeUrl(relativeUrl),
+    sourceFileName(sourceFileName),
+    outputFileName(outFileName),
+    sourceStartOffset(sourceStartOffset) {}
+
+  static bool compareByTitle(const Page& a, const Page& b)
+  {
+    return a.title < b.title;
+  }
+
+  static bool compareByUrl(const Page& a, const Page& b)
+  {
+    return a.relativeUrl < b.relativeUrl;
+  }
+
+  static SortingInformation<Page> compareBy(const std::string& member, bool ascending = true)
+  {
+    if (member == "title")
+      return SortingInformation<Page>(Page::compareByTitle, ascending);
+    else if (member == "url")
+      return SortingInformation<Page>(Page::compareByUrl, ascending);
+
+    logErrorFmt("Unable to sort Page list by unknown property '%s'", member.c_str());
+    return SortingInformation<Page>(Page::compareByTitle, ascending);
+  }
+};
+
+struct Post : public Page
+{
+  std::string layoutName;
+  std::string year;
+  std::string month;
+  std::string day;
+  std::string monthName;
+  int yearInt;
+  int monthInt;
+  int dayInt;
+
+  Post(std::string title,
+      std::string& relativeUrl,
+      std::string& sourceFileName,
+      std::string& outFileName,
+      std::string& layoutName,
+      std::string& day,
+      std::string& month,
+      std::string& year,
+      std::string& monthName):
+    Page(title, relativeUrl, sourceFileName, outFileName, 0),
+    layoutName(layoutName),
+    year(year),
+    month(month),
+    day(day),
+    monthName(monthName),
+    yearInt(std::atoi(year.c_str())),
+    monthInt(std::atoi(month.c_str())),
+    dayInt(std::atoi(day.c_str()))
+  {
+  }
+
+  bool isAttribute(std::string& attributeName) 
+  {
+    return attributeName == "title" 
+      || attributeName == "relativeUrl"
+      || attributeName == "title"
+      || attributeName == "url"
+      || attributeName == "layout"
+      || attributeName == "year"
+      || attributeName == "month"
+      || attributeName == "day"
+      || attributeName == "month_name";
+  }
+
+  static bool compareByTitle(const Post& a, const Post& b)
+  {
+    return a.title < b.title;
+  }
+
+  static bool compareByUrl(const Post& a, const Post& b)
+  {
+    return a.relativeUrl < b.relativeUrl;
+  }
+
+  static bool compareByLayout(const Post& a, const Post& b)
+  {
+    return a.layoutName < b.layoutName;
+  }
+
+  static bool compareByDate(const Post& a, const Post& b)
+  {
+    return a.yearInt < b.yearInt 
+      || (a.yearInt == b.yearInt && a.monthInt < b.monthInt )
+      || (a.yearInt == b.yearInt && a.monthInt == b.monthInt && a.dayInt < b.dayInt);
+  }
+
+  static bool compareByMonth(const Post& a, const Post& b)
+  {
+    return a.yearInt < b.yearInt 
+      || (a.yearInt == b.yearInt && a.monthInt < b.monthInt );
+  }
+
+  static bool compareByYear(const Post& a, const Post& b)
+  {
+    return a.yearInt < b.yearInt;
+  }
+
+  static SortingInformation<Post> compareBy(const std::string& member, bool ascending = true)
+  {
+    if (member == "title")
+      return SortingInformation<Post>(Post::compareByTitle, ascending);
+    else if (member == "url")
+      return SortingInformation<Post>(Post::compareByUrl, ascending);
+    else if (member == "layout")
+      return SortingInformation<Post>(Post::compareByLayout, ascending);
+    else if (member == "year")
+      return SortingInformation<Post>(Post::compareByYear, ascending);
+    else if (member == "month")
+      return SortingInformation<Post>(Post::compareByMonth, ascending);
+    else if (member == "day" || member == "date")
+      return SortingInformation<Post>(Post::compareByDate, ascending);
+
+    logErrorFmt("Unable to sort Post list by unknown property '%s'", member.c_str());
+    return SortingInformation<Post>(Post::compareByDate, ascending);
+  }
+};
+
+// Returns the indices of the list elements in sorted order. The list itself is left untouched.
+template<typename T>
+std::vector<size_t> sortedIndices(const std::vector<T>& list, const SortingInformation<T>& sorting)
+{
+  std::vector<size_t> indices(list.size());
+  for (size_t i = 0; i < indices.size(); i++)
+    indices[i] = i;
+
+  std::stable_sort(indices.begin(), indices.end(),
+      [&](size_t a, size_t b) { return sorting(list[a], list[b]); });
+  return indices;
+}
+
+#endif  // PAGE
@@ -0,0 +1,41 @@
+#ifndef PARALLEL
+#define PARALLEL
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Calls job(i) for every i in [0, count) using up to numJobs threads.
+// A numJobs of 0 uses one thread per hardware core.
+template<typename Job>
+void parallelFor(size_t count, int numJobs, Job job)
+{
+  size_t numThreads = numJobs > 0 ? (size_t) numJobs : std::thread::hardware_concurrency();
+  numThreads = std::max((size_t) 1, std::min(numThreads, count));
+
+  if (numThreads == 1)
+  {
+    for (size_t i = 0; i < count; i++)
+      job(i);
+    return;
+  }
+
+  std::atomic<size_t> nextIndex = 0;
+  auto worker = [&]()
+  {
+    size_t i;
+    while ((i = nextIndex++) < count)
+      job(i);
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < numThreads; i++)
+    threads.emplace_back(worker);
+
+  worker();
+  for (std::thread& thread : threads)
+    thread.join();
+}
+
+#endif  // PARALLEL
@@ -1,27 +1,149 @@
 #include "parser_utils.h"
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <errno.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-char* readFileToBuffer(const char* fileName, size_t* fileSize)
+FileBuffer::~FileBuffer()
+{
+  close();
+}
+
+FileBuffer::FileBuffer(FileBuffer&& other) noexcept
+{
+  *this = std::move(other);
+}
+
+FileBuffer& FileBuffer::operator=(FileBuffer&& other) noexcept
+{
+  if (this != &other)
+  {
+    close();
+    mapping = other.mapping;
+    mappingSize = other.mappingSize;
+    contents = std::move(other.contents);
+    other.mapping = nullptr;
+    other.mappingSize = 0;
+    other.contents.clear();
+  }
+  return *this;
+}
+
+void FileBuffer::close()
+{
+#ifndef _WIN32
+  if (mapping)
+    munmap((void*) mapping, mappingSize);
+#endif
+  mapping = nullptr;
+  mappingSize = 0;
+  contents.clear();
+}
+
+#ifndef _WIN32
+
+// Reads exactly size bytes, or fails
+static bool readAll(int fd, std::string& content, size_t size)
+{
+  content.resize(size);
+  size_t done = 0;
+  while (done < size)
+  {
+    ssize_t length = read(fd, content.data() + done, size - done);
+    if (length < 0 && errno == EINTR)
+      continue;
+    if (length <= 0)
+      break;
+    done += length;
+  }
+  content.resize(done);
+  return done == size;
+}
+
+bool FileBuffer::open(const char* fileName)
+{
+  close();
+  int fd = ::open(fileName, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    logErrorFmt("Could not open file '%s' for reading\n", fileName);
+    return false;
+  }
+
+  struct stat info;
+  bool success = fstat(fd, &info) == 0;
+  size_t fileSize = success ? (size_t) info.st_size : 0;
+  // The rest of the last page of a mapping reads as zeros, which keeps mapped
+  // buffers null terminated like read ones. Sizes that are a multiple of the
+  // page size have no such room left and are read instead.
+  const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+  if (success && fileSize >= FILE_MAP_THRESHOLD && fileSize % pageSize != 0)
+  {
+    void* address = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address != MAP_FAILED)
+    {
+      madvise(address, fileSize, MADV_SEQUENTIAL);
+      mapping = (const char*) address;
+      mappingSize = fileSize;
+    }
+    else
+    {
+      success = readAll(fd, contents, fileSize);
+    }
+  }
+  else if (success)
+  {
+    success = readAll(fd, contents, fileSize);
+  }
+
+  ::close(fd);
+  return success;
+}
+
+#else
+
+bool FileBuffer::open(const char* fileName)
+{
+  close();
+  return readFileToString(fileName, contents);
+}
+
+#endif  // _WIN32
+
+bool readFileToString(const char* fileName, std::string& content)
 {
   std::ifstream is(fileName, std::ifstream::binary);
   if(!is)
   {
     logErrorFmt("Could not open file '%s' for reading\n", fileName);
-    return nullptr;
+    return false;
   }
 
   is.seekg (0, is.end);
   size_t length = is.tellg();
   is.seekg (0, is.beg);
 
-  if(fileSize)
-    *fileSize = length;
+  content.resize(length);
+  is.read(content.data(), length);
+  return (size_t) is.gcount() == length;
+}
 
-  char* buffer = new char[length];
-  is.read (buffer,length);
-  is.close();
-  return buffer;
+// 64 bit FNV-1a
+uint64_t hashBuffer(const char* buffer, size_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= (unsigned char) buffer[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
 }
 
 bool substrCompare(char* str, char* start, char* end)
@@ -36,7 +158,28 @@ bool substrCompare(char* str, char* start, char* end)
     ++start;
     ++str;
   }
-  return true;
+
+  // The whole word must match, not just a prefix of it
+  return *str == 0;
+}
+
+// memchr is vectorized by the C library, so literal text is skipped many
+// bytes at a time. A '{' not followed by another one can't start an
+// expression at the next byte either, so both are skipped.
+const char* findExpressionStart(const char* p, const char* end)
+{
+  while (p < end)
+  {
+    p = (const char*) memchr(p, '{', end - p);
+    if (!p || p + 1 >= end)
+      return end;
+
+    if (p[1] == '{')
+      return p;
+
+    p += 2;
+  }
+  return end;
 }
 
 inline bool isEof(ParseContext& context) 
@@ -77,7 +220,7 @@ bool isLetter(char c)
 
 void skipWhiteSpace(ParseContext& context)
 {
-  while(isWhiteSpace(*context.p))
+  while(!isEof(context) && isWhiteSpace(*context.p))
   {
     getc(context);
   }
@@ -162,6 +305,17 @@ Token getToken(ParseContext& context)
     return token;
   }
 
+  // TOKEN_NUMBER
+  if (isDigit(c))
+  {
+    while(isDigit(peek(context)))
+      getc(context);
+
+    token.end = context.p;
+    token.type = Token::Type::TOKEN_NUMBER;
+    return token;
+  }
+
   if (isLetter(c) || c == '_')
   {
     while(isLetter(c) || isDigit(c) || c == '_' || c == '-' || c == '.')
@@ -2,11 +2,11 @@
 #define PARSER_UTILS
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include "log.h"
 
-#define logError(msg) printf("ERROR\t- " msg)
-#define logErrorFmt(fmt, ...) printf("ERROR\t- " fmt, __VA_ARGS__)
-#define logInfoFmt(fmt, ...) printf("INFO\t- " fmt, __VA_ARGS__)
-#define logInfo(msg) printf("INFO\t- " msg)
 #define END_OF_FILE -1
 
 struct ParseContext
@@ -35,6 +35,7 @@ struct Token
     TOKEN_PATH              = 11,  // Path between double quotes "foo/bar"
     TOKEN_ORDERBY_ASC       = 12,  // orderby_asc reserved word
     TOKEN_ORDERBY_DESC      = 13,  // orderby_desc reserved word
+    TOKEN_NUMBER            = 14,  // Unsigned integer literal
     TOKEN_UNKNOWN           = -1,  // Any unknown token 
     TOKEN_EOF               = -2,  // EOF
   };
@@ -46,10 +47,45 @@ struct Token
 
 Token getToken(ParseContext& context);
 
-char* readFileToBuffer(const char* fileName, size_t* fileSize = nullptr);
+// Read-only contents of a file. Files of FILE_MAP_THRESHOLD bytes or more
+// are memory mapped with a sequential access hint, smaller ones are read
+// into memory. Either way data() is null terminated. The memory is released
+// when the buffer is destroyed.
+struct FileBuffer
+{
+  FileBuffer() = default;
+  ~FileBuffer();
+
+  FileBuffer(FileBuffer&& other) noexcept;
+  FileBuffer& operator=(FileBuffer&& other) noexcept;
+  FileBuffer(const FileBuffer&) = delete;
+  FileBuffer& operator=(const FileBuffer&) = delete;
+
+  // Replaces the contents with the file's. Returns false if it can't be read.
+  bool open(const char* fileName);
+  void close();
+
+  const char* data() const { return mapping ? mapping : contents.data(); }
+  size_t size() const { return mapping ? mappingSize : contents.size(); }
+  bool empty() const { return size() == 0; }
+  std::string_view view() const { return std::string_view(data(), size()); }
+
+  const char* mapping = nullptr;
+  size_t mappingSize = 0;
+  std::string contents;   // small files
+};
+
+const size_t FILE_MAP_THRESHOLD = 256 * 1024;
+
+bool readFileToString(const char* fileName, std::string& content);
+
+uint64_t hashBuffer(const char* buffer, size_t size);
 
 bool substrCompare(char* str, char* start, char* end);
 
+// Returns the first "{{" in [p, end), or end if there is none
+const char* findExpressionStart(const char* p, const char* end);
+
 bool isEof(ParseContext& context);
 
 bool isWhiteSpace(char c); 
@@ -0,0 +1,799 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include "site.h"
+#include "arena.h"
+#include "assets.h"
+#include "feed.h"
+#include "markdown.h"
+#include "minify.h"
+#include "parallel.h"
+#include "parser_utils.h"
+#include "trace.h"
+#include "watch.h"
+
+std::string& toLower(std::string& str)
+{
+  size_t len = str.length();
+  for(size_t i=0; i < len; i++)
+  {
+    char c = str[i];
+
+    str[i] = (char) tolower(c);
+  }
+  return str;
+}
+
+std::unordered_map<std::string, std::string>* loadSiteConfigFile(std::filesystem::path& siteConfigFile)
+{
+  std::string fileName = siteConfigFile.string();
+  FileBuffer file;
+  if (!file.open(fileName.c_str()))
+  {
+    logErrorFmt("Unable to open site config file '%s'\n", fileName.c_str());
+    return nullptr;
+  }
+
+  ParseContext context;
+  context.fileName = fileName.c_str();
+  context.source = file.data();
+  context.eof = (char*) file.data() + file.size();
+  context.p = (char*) context.source;
+
+  bool success = true;
+  std::unordered_map<std::string, std::string> *variablesPtr = new std::unordered_map<std::string, std::string>();
+  std::unordered_map<std::string, std::string>& variables = *variablesPtr;
+
+  // set some default values
+
+  std::filesystem::path siteRootFolder = siteConfigFile;
+  siteRootFolder.remove_filename();
+  variables["site.root_dir"] = siteRootFolder.string();
+  variables["site.name"] = "Undefined";
+  variables["site.url"] = "http://";
+  variables["site.templates_dir"] = "template";
+  variables["site.posts_dir"]     = "posts";
+  variables["site.pages_dir"]     = "pages";
+  variables["month_01"]           = "JAN";
+  variables["month_02"]           = "FEB";
+  variables["month_03"]           = "MAR";
+  variables["month_04"]           = "APR";
+  variables["month_05"]           = "MAY";
+  variables["month_06"]           = "JUN";
+  variables["month_07"]           = "JUL";
+  variables["month_08"]           = "AUG";
+  variables["month_09"]           = "SEP";
+  variables["month_10"]           = "OCT";
+  variables["month_11"]           = "NOV";
+  variables["month_12"]           = "DEC";
+
+  while (context.p < context.eof)
+  {
+    Token value;
+    Token key = getToken(context);
+
+    if (key.type == Token::Type::TOKEN_EOL)
+    {
+      continue;
+    }
+
+    if (! (requireToken(context, Token::Type::TOKEN_ASSIGN)
+          && requireToken(context, Token::Type::TOKEN_PATH, &value)))
+    {
+      success = false;
+      break;
+    }
+
+    //this might be an EOL line or an EOF
+    Token token = getToken(context);
+    if (token.type != Token::Type::TOKEN_EOL && token.type != Token::Type::TOKEN_EOF)
+    {
+      success = false;
+      break;
+    }
+
+    std::string sKey = std::string(key.start, key.end - key.start);
+    std::string sValue = std::string(value.start, value.end - value.start);
+    variables[sKey] = sValue;   
+  }
+
+
+  // if templates dir is not absolute, consider it's relative to site.txt folder location
+  std::filesystem::path templatesDir = variables["site.templates_dir"];
+  if (templatesDir.is_relative())
+  {
+    templatesDir = siteRootFolder / templatesDir;
+    variables["site.templates_dir"] = templatesDir.string();
+  }
+
+  // if posts_src dir is not absolute, consider it's relative to site.txt folder location
+  std::filesystem::path postsSrcDir = variables["site.posts_dir"];
+  if (postsSrcDir.is_relative())
+  {
+    postsSrcDir = siteRootFolder / postsSrcDir;
+    variables["site.posts_dir"] = postsSrcDir.string();
+  }
+
+  // if pages_dir is not absolute, consider it's relative to site.txt folder location
+  std::filesystem::path pagesSrcDir = variables["site.pages_dir"];
+  if (pagesSrcDir.is_relative())
+  {
+    pagesSrcDir = siteRootFolder / pagesSrcDir;
+    variables["site.pages_dir"] = pagesSrcDir.string();
+  }
+
+  if (!success)
+  {
+    logError("Error parsing site config file.\n");
+    delete variablesPtr;
+    return nullptr;
+  }
+
+  return variablesPtr;
+}
+
+// Reads the first line of the file, with its line break. Title overrides are
+// parsed from it without reading the rest of the file.
+bool readFirstLine(const std::string& fileName, std::string& line)
+{
+  std::ifstream file(fileName, std::ifstream::binary);
+  if (!file.is_open())
+    return false;
+
+  getline(file, line);
+  if (!file.eof())
+    line += '\n';
+  return true;
+}
+
+bool readTitleOverride(const std::string& fileName, std::string& title, size_t* sourceStartOffset)
+{
+  std::string line;
+  if (!readFirstLine(fileName, line))
+    return false;
+
+  size_t offset = parseTitleOverride(line, title);
+  if (sourceStartOffset)
+    *sourceStartOffset = offset;
+  return offset != 0;
+}
+
+bool loadPostTitle(Post& post)
+{
+  std::string line;
+  if (!readFirstLine(post.sourceFileName, line))
+    return false;
+
+  std::string title;
+  post.sourceStartOffset = parseTitleOverride(line, title);
+  if (post.sourceStartOffset)
+    post.title = title;
+  return true;
+}
+
+// Renders the page to output. Pages with a paginated loop render one more
+// output per extra page needed to show the whole collection.
+bool renderPage(const Page& page, RenderContext& context, std::string& output, std::vector<RenderOutput>& extraOutputs)
+{
+  logVerboseFmt("Processing page %s\n", page.sourceFileName.c_str());
+  // Loops push scopes, so the page scope is kept by index
+  size_t scopeIndex = context.scopes.size();
+  context.scopes.emplace_back(SYMBOL_PAGE, &page);
+
+  // Pages are rendered only once, so they are not kept in the template cache
+  Template pageTemplate;
+  if (!loadTemplate(pageTemplate, page.sourceFileName, context.templateRoot, context.variables, page.sourceStartOffset))
+    return false;
+
+  size_t numPages = countPaginationPages(pageTemplate, context);
+  if (numPages <= 1)
+    return processPage(pageTemplate, context, output);
+
+  for (size_t i = 0; i < numPages; i++)
+  {
+    Pagination pagination;
+    pagination.number = std::to_string(i + 1);
+    pagination.numPages = std::to_string(numPages);
+    pagination.root = getRootPath(getPaginationUrl(page.relativeUrl, i));
+    if (i > 0)
+      pagination.prevUrl = pagination.root + getPaginationUrl(page.relativeUrl, i - 1);
+    if (i + 1 < numPages)
+      pagination.nextUrl = pagination.root + getPaginationUrl(page.relativeUrl, i + 1);
+
+    context.scopes[scopeIndex].pagination = &pagination;
+    context.pageIndex = i;
+    context.root = pagination.root;
+
+    std::string* pageOutput = &output;
+    if (i > 0)
+    {
+      RenderOutput& extraOutput = extraOutputs.emplace_back();
+      extraOutput.relativeUrl = getPaginationUrl(page.relativeUrl, i);
+      extraOutput.content.reserve(output.capacity());
+      pageOutput = &extraOutput.content;
+    }
+
+    if (!processPage(pageTemplate, context, *pageOutput))
+      return false;
+  }
+
+  context.scopes[scopeIndex].pagination = nullptr;
+  context.root = std::string_view();
+  return true;
+}
+
+// The converted markdown is also returned on body, when not null
+bool renderPost(Site& site, Post& post, RenderContext& context, std::string& output,
+    std::shared_ptr<const std::string>* body = nullptr)
+{
+  logVerboseFmt("Processing post %s\n", post.sourceFileName.c_str());
+
+  std::string layoutFileName = (site.layoutDirectory / post.layoutName).concat(".html").string();
+
+  // The converted html is shared with the watch mode cache instead of copied
+  std::shared_ptr<const std::string> htmlSource;
+  if (site.options.watch)
+  {
+    std::lock_guard<std::mutex> lock(site.markdownCacheMutex);
+    auto it = site.markdownCache.find(post.sourceFileName);
+    if (it != site.markdownCache.end())
+      htmlSource = it->second;
+  }
+
+  if (!htmlSource)
+  {
+    // The buffer only lives while the post is converted
+    FileBuffer source;
+    {
+      TraceSpan span("read post", post.sourceFileName);
+      if (!source.open(post.sourceFileName.c_str()))
+        return false;
+    }
+
+    size_t bodyOffset = std::min(post.sourceStartOffset, source.size());
+    TraceSpan span("markdown", post.sourceFileName);
+    htmlSource = std::make_shared<const std::string>(markdownToHtml(source.view().substr(bodyOffset), context.arena));
+    if (site.options.watch)
+    {
+      std::lock_guard<std::mutex> lock(site.markdownCacheMutex);
+      site.markdownCache[post.sourceFileName] = htmlSource;
+    }
+  }
+
+  // Export the post data as "post.xxx" variables and, as the template data,
+  // its title and url as "page.xxx" ones
+  if (body)
+    *body = htmlSource;
+
+  context.scopes.emplace_back(SYMBOL_POST, &post, &post).body = *htmlSource;
+  context.scopes.emplace_back(SYMBOL_PAGE, &post);
+
+  Template* layout = getTemplate(context, layoutFileName);
+  return layout && processPage(*layout, context, output);
+}
+
+bool loadSite(Site& site)
+{
+  TraceSpan span("load config");
+  site.siteConfigFile = site.inputDirectory / "site.txt";
+  std::unordered_map<std::string, std::string>* variablesPtr = loadSiteConfigFile(site.siteConfigFile);
+  if (!variablesPtr)
+    return false;
+
+  site.variables = std::move(*variablesPtr);
+  delete variablesPtr;
+
+  std::unordered_map<std::string, std::string>& variables = site.variables;
+  site.templateDirectory = strToNormalizedPath(variables["site.templates_dir"]);
+  site.postsDirectory = strToNormalizedPath(variables["site.posts_dir"]);
+  site.pagesDirectory = strToNormalizedPath(variables["site.pages_dir"]);
+  site.layoutDirectory = site.templateDirectory / "layout";
+
+  logInfoFmt("Generating site to %s\n", site.outputDirectory.string().c_str());
+  logVerboseFmt("site file\t= %s\n", site.siteConfigFile.string().c_str());
+  logVerboseFmt("templates dir\t= %s\n", site.templateDirectory.string().c_str());
+  logVerboseFmt("posts dir\t= %s\n", site.postsDirectory.string().c_str());
+  logVerboseFmt("pages dir\t= %s\n", site.pagesDirectory.string().c_str());
+  logVerboseFmt("layout dir\t= %s\n", site.layoutDirectory.string().c_str());
+  return true;
+}
+
+bool collectPages(Site& site)
+{
+  TraceSpan span("collect pages");
+  site.pageList.clear();
+  std::vector<std::filesystem::path> pageFiles;
+  if (!scanDirectory(site.templateDirectory, ".html", pageFiles))
+  {
+    return false;
+  }
+
+  for(const std::filesystem::path& path : pageFiles)
+  {
+    std::string fileName = path.filename().string();
+    std::string title = fileName.substr(0, fileName.find("."));
+    std::string relativeUrl = toLower((std::string&)fileName);
+    std::string sourceFileName = (site.templateDirectory / fileName).string();
+    std::string outputFileName = (site.outputDirectory / relativeUrl).string();
+    size_t sourceStartOffset = 0;
+
+    // check for title override in the first line of the file
+    readTitleOverride(sourceFileName, title, &sourceStartOffset);
+
+    site.pageList.emplace_back(title, relativeUrl, sourceFileName, outputFileName, sourceStartOffset);
+  }
+
+  site.variables["site.num_pages"] = std::to_string((int)site.pageList.size());
+  return true;
+}
+
+// Collect Content and Layout info
+bool collectPosts(Site& site, bool& hasWarnings)
+{
+  TraceSpan span("collect posts");
+  site.postList.clear();
+  std::vector<std::filesystem::path> postFiles;
+  {
+    TraceSpan scanSpan("scan posts", traceDetail(site.postsDirectory));
+    if (!scanDirectoryRecursive(site.postsDirectory, ".md", site.options.numJobs, site.postsScanCache, postFiles))
+    {
+      return false;
+    }
+  }
+
+  bool hasErrors = false;
+  const int TIMESTAMP_LEN = 8;  //AAAAMMDD = 8 chars
+  const int MINIMUM_FILE_NAME_LEN = TIMESTAMP_LEN + 2 - 3; // -AAAAMMDD- = 10 chars; .md = 3 chars
+
+  std::erase(postFiles, site.siteConfigFile); // ignore the site config file
+  PostIndex postIndex;
+  for(auto it = postFiles.rbegin(); it != postFiles.rend(); ++it)
+  {
+    std::string fileName = (*it).filename().string();
+    if (fileName.length() <= MINIMUM_FILE_NAME_LEN)
+    {
+      logInfoFmt("Ignoring file '%s'. Name is too short to fit correct formatting.\n", fileName.c_str());
+      continue;
+    }
+
+    std::string layoutName = fileName.substr(0, fileName.find("-"));
+    std::string timestamp = fileName.substr(layoutName.length() + 1, TIMESTAMP_LEN);
+    const size_t layoutNameLen = layoutName.length();
+    const size_t titleLen = fileName.length() - layoutNameLen - MINIMUM_FILE_NAME_LEN;
+
+    // Fill in the content data
+    std::string title = fileName.substr(layoutName.length() + 10, titleLen);
+    std::string sourceFileName = it->string();
+    std::string relativeUrl = timestamp + "_" + title + ".html";
+    toLower(relativeUrl);
+    std::string day = timestamp.substr(6, 2).c_str();
+    std::string month = timestamp.substr(4, 2).c_str();
+    std::string year = timestamp.substr(0, 4).c_str();
+    std::string monthName = site.variables["month_" + month];
+    std::string outputFileName = (site.outputDirectory / relativeUrl).string();
+
+    int dayValue = std::atoi(day.c_str());
+    int monthValue = std::atoi(month.c_str());
+    int yearValue = std::atoi(month.c_str());
+
+    // Does it have a valid timestamp ?
+    if (dayValue == 0 || monthValue == 0 || yearValue == 0 || dayValue > 30 || monthValue > 12)
+    {
+      hasWarnings = true;
+      logErrorFmt("%s: Invalid date format.\n", fileName.c_str());
+    }
+
+    // Does it have a valid layout ?
+    std::string layoutFileName = (site.layoutDirectory / layoutName).concat(".html").string();
+    toLower(layoutFileName);
+    if (std::filesystem::exists(layoutFileName) == false)
+    {
+      hasErrors = true;
+      logErrorFmt("%s: References unknown Layout file '%s'.\n", fileName.c_str(), layoutFileName.c_str());
+    }
+
+    if (hasErrors)
+    {
+      logErrorFmt("%s: Skipping file.\n", fileName.c_str());
+      hasWarnings = false;
+      continue;
+    }
+
+    Post& post = site.postList.emplace_back(title, relativeUrl, sourceFileName, outputFileName,
+        layoutName, day, month, year, monthName);
+
+    // Posts that did not change since they were indexed take their title
+    // override from the index and are only read when rendered. Any other
+    // post has its first line read now to check for a title override.
+    PostIndexEntry entry;
+    if (!getFileInfo(sourceFileName, entry.lastWriteTime, entry.size))
+    {
+      logErrorFmt("%s: Skipping file.\n", fileName.c_str());
+      site.postList.pop_back();
+      continue;
+    }
+
+    auto indexIt = site.postIndex.find(sourceFileName);
+    if (indexIt != site.postIndex.end()
+        && indexIt->second.lastWriteTime == entry.lastWriteTime
+        && indexIt->second.size == entry.size)
+    {
+      entry = std::move(indexIt->second);
+      post.sourceStartOffset = entry.sourceStartOffset;
+      if (post.sourceStartOffset)
+        post.title = entry.title;
+    }
+    else if (!loadPostTitle(post))
+    {
+      logErrorFmt("%s: Skipping file.\n", fileName.c_str());
+      site.postList.pop_back();
+      continue;
+    }
+    else
+    {
+      entry.sourceStartOffset = post.sourceStartOffset;
+      if (post.sourceStartOffset)
+        entry.title = post.title;
+    }
+
+    postIndex[sourceFileName] = std::move(entry);
+  }
+
+  site.postIndex = std::move(postIndex);
+
+  site.variables["site.num_posts"] = std::to_string((int)site.postList.size());
+  return !hasErrors;
+}
+
+// Html outputs are minified with --minify before they are hashed and written
+void minifyOutput(const std::string& fileName, std::string& content, SizeStats& stats)
+{
+  if (!fileName.ends_with(".html") && !fileName.ends_with(".htm"))
+    return;
+
+  TraceSpan span("minify", fileName);
+  std::string minified;
+  minified.reserve(content.length());
+  minifyHtml(content, minified);
+
+  stats.numFiles.fetch_add(1, std::memory_order_relaxed);
+  stats.inputBytes.fetch_add(content.length(), std::memory_order_relaxed);
+  stats.outputBytes.fetch_add(minified.length(), std::memory_order_relaxed);
+  content.swap(minified);
+}
+
+bool renderSite(Site& site, const std::vector<bool>* dirty)
+{
+  TraceSpan span("render site");
+  // Render pages and posts. Each render job has its own variable scope so
+  // they can safely run in parallel.
+  const size_t numPages = site.pageList.size();
+  const size_t numJobs = numPages + site.postList.size();
+  std::vector<ManifestEntry> outputEntries(numJobs);
+  std::vector<WriteResult> writeResults(numJobs, WRITE_FAILED);
+  std::vector<std::vector<RenderOutput>> extraOutputs(numJobs);
+  std::vector<RenderDependencies> dependencies(site.options.watch ? numJobs : 0);
+  std::vector<ArenaStats> arenaStats(numJobs);
+  const OutputManifest& previousManifest = site.manifest;
+  SizeStats minifyStats;
+  SizeStats gzipStats;
+  SizeStats* gzip = site.options.gzip ? &gzipStats : nullptr;
+
+  // Bodies of the posts on the feed are kept from their render
+  FeedOptions feedOptions = getFeedOptions(site);
+  std::vector<size_t> feedPosts;
+  std::vector<std::shared_ptr<const std::string>> postBodies;
+  std::vector<bool> keepBody;
+  if (!feedOptions.fileName.empty())
+    feedPosts = getFeedPosts(site.postList, feedOptions.numItems);
+
+  if (!feedOptions.fileName.empty() && feedOptions.content)
+  {
+    postBodies.resize(site.postList.size());
+    keepBody.resize(site.postList.size(), false);
+    for (size_t index : feedPosts)
+      keepBody[index] = true;
+  }
+
+  // Collections may have changed since the last build
+  SortedViews sortedViews;
+
+  auto outputPage = [&](size_t jobIndex) -> const Page&
+  {
+    return jobIndex < numPages ? site.pageList[jobIndex] : site.postList[jobIndex - numPages];
+  };
+
+  parallelFor(numJobs, site.options.numJobs, [&](size_t jobIndex)
+  {
+    if (dirty && !(*dirty)[jobIndex])
+      return;
+
+    const Page& page = outputPage(jobIndex);
+    auto it = previousManifest.find(page.relativeUrl);
+    const ManifestEntry* previousEntry = it == previousManifest.end() ? nullptr : &it->second;
+
+    // Output usually keeps about the same size from one build to the next
+    std::string output;
+    if (previousEntry)
+      output.reserve(previousEntry->size);
+
+    RenderArena& arena = getRenderArena();
+    bool success;
+    {
+      RenderContext renderContext = {site.templateDirectory, site.variables, site.pageList, site.postList, site.templateCache, sortedViews,
+        site.assetUrls, std::pmr::vector<Scope>(&arena), nullptr, std::pmr::vector<const Template*>(&arena), 0, &arena, std::string_view()};
+      if (site.options.watch)
+        renderContext.dependencies = &dependencies[jobIndex];
+
+      TraceSpan span("render", page.sourceFileName);
+      success = jobIndex < numPages ?
+        renderPage(page, renderContext, output, extraOutputs[jobIndex]) :
+        renderPost(site, site.postList[jobIndex - numPages], renderContext, output,
+            !keepBody.empty() && keepBody[jobIndex - numPages] ? &postBodies[jobIndex - numPages] : nullptr);
+    }
+    arenaStats[jobIndex] = arena.stats;
+
+    // Failed renders leave the previous output untouched
+    if (success)
+    {
+      if (site.options.minify)
+      {
+        minifyOutput(page.outputFileName, output, minifyStats);
+        for (RenderOutput& extraOutput : extraOutputs[jobIndex])
+          minifyOutput(extraOutput.relativeUrl, extraOutput.content, minifyStats);
+      }
+
+      writeResults[jobIndex] = writeOutputFile(page.outputFileName, output, previousEntry, outputEntries[jobIndex], gzip);
+
+      for (RenderOutput& extraOutput : extraOutputs[jobIndex])
+      {
+        std::filesystem::path outputFileName = site.outputDirectory / extraOutput.relativeUrl;
+        std::error_code error;
+        std::filesystem::create_directories(outputFileName.parent_path(), error);
+
+        auto extraIt = previousManifest.find(extraOutput.relativeUrl);
+        extraOutput.result = writeOutputFile(outputFileName.string(), extraOutput.content,
+            extraIt == previousManifest.end() ? nullptr : &extraIt->second, extraOutput.entry, gzip);
+        extraOutput.content = std::string();
+      }
+    }
+
+    logVerboseFmt("%s: %zu allocations (%zu bytes) from the arena, %zu from the heap\n", page.relativeUrl.c_str(),
+        arenaStats[jobIndex].numAllocations, arenaStats[jobIndex].numBytes, arenaStats[jobIndex].numHeapAllocations);
+    arena.reset();
+  });
+
+  // Build the new manifest and remove outputs that are no longer generated
+  OutputManifest manifest;
+  bool hasErrors = false;
+  size_t numWritten = 0;
+  size_t numUnchanged = 0;
+  size_t numRemoved = 0;
+  for (size_t i = 0; i < numJobs; i++)
+  {
+    const Page& page = outputPage(i);
+    auto previous = previousManifest.find(page.relativeUrl);
+    bool rendered = !dirty || (*dirty)[i];
+
+    if (rendered && site.options.watch)
+      site.dependencies[page.relativeUrl] = std::move(dependencies[i]);
+
+    if (rendered && writeResults[i] == WRITE_FAILED)
+      hasErrors = true;
+
+    if (!rendered || writeResults[i] == WRITE_FAILED)
+    {
+      if (previous != previousManifest.end())
+        manifest[page.relativeUrl] = previous->second;
+
+      // Keep the pagination pages of pages that were not rendered again
+      if (i < numPages)
+      {
+        std::string paginationPrefix = getPaginationUrl(page.relativeUrl, 1);
+        paginationPrefix.erase(paginationPrefix.rfind('/') + 1);
+        for (auto& it : previousManifest)
+        {
+          if (it.first.starts_with(paginationPrefix))
+            manifest.insert(it);
+        }
+      }
+      continue;
+    }
+
+    manifest[page.relativeUrl] = outputEntries[i];
+    if (writeResults[i] == WRITE_WRITTEN)
+      numWritten++;
+    else
+      numUnchanged++;
+
+    for (RenderOutput& extraOutput : extraOutputs[i])
+    {
+      if (extraOutput.result == WRITE_FAILED)
+      {
+        hasErrors = true;
+        auto extraIt = previousManifest.find(extraOutput.relativeUrl);
+        if (extraIt != previousManifest.end())
+          manifest.insert(*extraIt);
+        continue;
+      }
+
+      manifest[extraOutput.relativeUrl] = extraOutput.entry;
+      if (extraOutput.result == WRITE_WRITTEN)
+        numWritten++;
+      else
+        numUnchanged++;
+    }
+  }
+
+  // Feed and sitemaps, once every page and post output is known
+  std::vector<RenderOutput> siteOutputs;
+  if (!feedOptions.fileName.empty())
+  {
+    RenderOutput& feed = siteOutputs.emplace_back();
+    feed.relativeUrl = feedOptions.fileName;
+    writeFeed(site, feedOptions, feedPosts, postBodies, feed.content);
+  }
+
+  auto sitemapIt = site.variables.find("site.sitemap");
+  if (sitemapIt != site.variables.end() && !sitemapIt->second.empty())
+    writeSitemaps(site, sitemapIt->second, manifest, siteOutputs);
+
+  for (RenderOutput& siteOutput : siteOutputs)
+  {
+    std::filesystem::path outputFileName = site.outputDirectory / siteOutput.relativeUrl;
+    std::error_code error;
+    std::filesystem::create_directories(outputFileName.parent_path(), error);
+
+    auto previous = previousManifest.find(siteOutput.relativeUrl);
+    siteOutput.result = writeOutputFile(outputFileName.string(), siteOutput.content,
+        previous == previousManifest.end() ? nullptr : &previous->second, siteOutput.entry, gzip);
+
+    if (siteOutput.result == WRITE_FAILED)
+    {
+      hasErrors = true;
+      if (previous != previousManifest.end())
+        manifest.insert(*previous);
+      continue;
+    }
+
+    manifest[siteOutput.relativeUrl] = siteOutput.entry;
+    if (siteOutput.result == WRITE_WRITTEN)
+      numWritten++;
+    else
+      numUnchanged++;
+  }
+
+  for (auto& it : previousManifest)
+  {
+    if (manifest.find(it.first) != manifest.end())
+      continue;
+
+    site.dependencies.erase(it.first);
+    std::error_code error;
+    std::filesystem::path outputFileName = site.outputDirectory / it.first;
+    if (std::filesystem::remove(outputFileName, error))
+      numRemoved++;
+
+    outputFileName += ".gz";
+    std::filesystem::remove(outputFileName, error);
+  }
+
+  site.manifest = std::move(manifest);
+  if (site.options.incremental)
+    saveOutputManifest(site.options.cacheDirectory, site.manifest);
+
+  // The scan cache and post index are only kept once their outputs are written
+  if (site.options.incremental && !hasErrors)
+  {
+    saveScanCache(site.options.cacheDirectory, site.postsScanCache);
+    savePostIndex(site.options.cacheDirectory, site.postIndex);
+  }
+  site.stats.arena = ArenaStats();
+  for (const ArenaStats& stats : arenaStats)
+  {
+    site.stats.arena.numAllocations += stats.numAllocations;
+    site.stats.arena.numBytes += stats.numBytes;
+    site.stats.arena.numHeapAllocations += stats.numHeapAllocations;
+  }
+
+  site.stats.numWritten = numWritten;
+  site.stats.numUnchanged = numUnchanged;
+  site.stats.numRemoved = numRemoved;
+  site.stats.numMinified = minifyStats.numFiles;
+  site.stats.minifyInputBytes = minifyStats.inputBytes;
+  site.stats.minifyOutputBytes = minifyStats.outputBytes;
+  site.stats.numGzipped = gzipStats.numFiles;
+  site.stats.gzipInputBytes = gzipStats.inputBytes;
+  site.stats.gzipOutputBytes = gzipStats.outputBytes;
+  return !hasErrors;
+}
+
+int generateSite(std::filesystem::path& inputDirectory, std::filesystem::path& outputDirectory, const BuildOptions& options)
+{
+  setLogLevel(options.logLevel);
+  if (!options.traceFileName.empty())
+    enableTrace();
+
+  auto start = std::chrono::system_clock::now();
+  bool hasErrors = false;
+  bool hasWarnings = false;
+
+  Site site;
+  site.options = options;
+  site.inputDirectory = inputDirectory;
+  site.outputDirectory = outputDirectory;
+
+  // Incremental builds keep the output directory and only touch what changed.
+  // Full builds still read the manifest left by an incremental build to size
+  // output buffers up front, then drop it: the outputs it describes are gone.
+  loadOutputManifest(options.cacheDirectory, site.manifest);
+  if (options.incremental)
+  {
+    loadScanCache(options.cacheDirectory, site.postsScanCache);
+    loadPostIndex(options.cacheDirectory, site.postIndex);
+    loadAssetIndex(options.cacheDirectory, site.assetIndex);
+  }
+  else
+  {
+    std::filesystem::remove_all(outputDirectory);
+    removeBuildState(options.cacheDirectory);
+  }
+
+  // Try to create the output directory in case it does not exist
+  std::filesystem::create_directories(outputDirectory);
+
+  {
+    TraceSpan span("build");
+    if (!loadSite(site))
+    {
+      logInfo("Generation Failed\n");
+      return 1;
+    }
+
+    if (!collectPages(site))
+      hasErrors = true;
+
+    if (!collectPosts(site, hasWarnings))
+      hasErrors = true;
+
+    collectSiteAssets(site);
+    if (!renderSite(site, nullptr))
+      hasErrors = true;
+
+    if (hasErrors == false)
+    {
+      copyAssets(site);
+
+      auto end = std::chrono::system_clock::now();
+      auto buildTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+      const BuildStats& stats = site.stats;
+      logInfoFmt("%zu pages, %zu posts: %zu files written, %zu unchanged, %zu removed\n",
+          site.pageList.size(), site.postList.size(), stats.numWritten, stats.numUnchanged, stats.numRemoved);
+      logInfoFmt("%zu assets copied (%llu bytes), %zu unchanged, %zu removed\n", stats.numAssetsCopied,
+          (unsigned long long) stats.assetBytesCopied, stats.numAssetsUnchanged, stats.numAssetsRemoved);
+      if (options.minify)
+        logInfoFmt("%zu files minified, %llu bytes saved (%llu bytes to %llu)\n", stats.numMinified,
+            (unsigned long long) (stats.minifyInputBytes - stats.minifyOutputBytes),
+            (unsigned long long) stats.minifyInputBytes, (unsigned long long) stats.minifyOutputBytes);
+      if (options.gzip)
+        logInfoFmt("%zu files gzipped (%llu bytes to %llu)\n", stats.numGzipped,
+            (unsigned long long) stats.gzipInputBytes, (unsigned long long) stats.gzipOutputBytes);
+      logVerboseFmt("%zu render allocations (%zu bytes) from the arenas, %zu from the heap\n",
+          stats.arena.numAllocations, stats.arena.numBytes, stats.arena.numHeapAllocations);
+      logInfoFmt("Site generated in %ldms\n", (long) buildTime);
+    }
+  }
+
+  if (!options.traceFileName.empty() && writeTrace(options.traceFileName.c_str()))
+    logInfoFmt("Trace written to %s\n", options.traceFileName.c_str());
+
+  const char* message = hasErrors ? "Generation Failed\n" : hasWarnings ? "Success (with warnings)\n" : "Success\n";
+  logInfoFmt("%s", message);
+  flushLog();
+
+  if (options.watch)
+    return watchSite(site);
+
+  return hasErrors ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+#ifndef SITE
+#define SITE
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+#include "assets.h"
+#include "log.h"
+#include "manifest.h"
+#include "page.h"
+#include "template.h"
+
+struct BuildOptions
+{
+  int numJobs = 1;
+  bool incremental = false;
+  std::filesystem::path cacheDirectory;  // Where incremental builds keep their state
+  bool watch = false;
+  bool minify = false;  // strip comments and whitespace that doesn't render from html outputs
+  bool gzip = false;  // write a .gz sibling next to every text output and asset
+  std::string traceFileName;  // Chrome trace event JSON output, when not empty
+  LogLevel logLevel = LOG_LEVEL_INFO;
+};
+
+// Counts of the last build, reported once it is done
+struct BuildStats
+{
+  size_t numWritten = 0;
+  size_t numUnchanged = 0;
+  size_t numRemoved = 0;
+  size_t numAssetsCopied = 0;
+  size_t numAssetsUnchanged = 0;
+  size_t numAssetsRemoved = 0;
+  uintmax_t assetBytesCopied = 0;
+  size_t numMinified = 0;
+  uintmax_t minifyInputBytes = 0;
+  uintmax_t minifyOutputBytes = 0;
+  size_t numGzipped = 0;  // outputs and assets
+  uintmax_t gzipInputBytes = 0;
+  uintmax_t gzipOutputBytes = 0;
+  ArenaStats arena;  // summed over all renders
+};
+
+// Everything loaded for a build. Watch mode keeps it alive between builds, so
+// compiled templates and converted markdown are reused across rebuilds.
+struct Site
+{
+  BuildOptions options;
+  std::filesystem::path inputDirectory;
+  std::filesystem::path outputDirectory;
+  std::filesystem::path siteConfigFile;
+  std::filesystem::path templateDirectory;
+  std::filesystem::path postsDirectory;
+  std::filesystem::path pagesDirectory;
+  std::filesystem::path layoutDirectory;
+  std::unordered_map<std::string, std::string> variables;
+  std::vector<Page> pageList;
+  std::vector<Post> postList;
+  TemplateCache templateCache;
+  OutputManifest manifest;
+  ScanCache postsScanCache;
+  PostIndex postIndex;
+  std::unordered_map<std::string, RenderDependencies> dependencies;  // by output url
+  std::unordered_map<std::string, std::shared_ptr<const std::string>> markdownCache;  // post html by source file
+  std::mutex markdownCacheMutex;
+  std::vector<AssetFile> assets;
+  std::unordered_map<std::string, std::string> assetUrls;  // output url by asset path
+  AssetIndex assetIndex;
+  BuildStats stats;
+};
+
+bool loadSite(Site& site);
+
+// Collect Page info
+bool collectPages(Site& site);
+
+bool collectPosts(Site& site, bool& hasWarnings);
+
+// Renders the pages and posts flagged on dirty (or all of them when dirty is
+// null), writes the ones that changed and removes outputs no longer generated.
+// Returns false if any render failed.
+bool renderSite(Site& site, const std::vector<bool>* dirty);
+
+// Reads the title override block, if present on the first line of the file.
+bool readTitleOverride(const std::string& fileName, std::string& title, size_t* sourceStartOffset = nullptr);
+
+// Reads the post title override. Only the first line of the file is read,
+// the whole file is read once, when the post is rendered.
+bool loadPostTitle(Post& post);
+
+int generateSite(std::filesystem::path& inputDirectory, std::filesystem::path& outputDirectory, const BuildOptions& options);
+
+#endif  // SITE
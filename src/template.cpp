@@ -0,0 +1,803 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include "template.h"
+#include "markdown.h"
+#include "trace.h"
+
+void logMismatchedTokenType(Token::Type expected, Token::Type found)
+{
+  logErrorFmt("Unexpected token type '%d' while expecting '%d'\n", found, expected);
+}
+
+bool requireToken(ParseContext& context, Token::Type requiredType, Token* tokenFound)
+{
+  Token token = getToken(context);
+  if(tokenFound) *tokenFound = token;
+  if (token.type != requiredType)
+  {
+    logMismatchedTokenType(requiredType, token.type);
+    return false;
+  }
+  return true;
+}
+
+std::string normalizedPathKey(const std::filesystem::path& path)
+{
+  return path.lexically_normal().string();
+}
+
+std::filesystem::path strToNormalizedPath(std::string& strPath)
+{
+  char nativeSep = std::filesystem::path::preferred_separator;
+  char nonNativeSep = (nativeSep == '/') ? '\\' : '/';
+  std::replace(strPath.begin(), strPath.end(), nonNativeSep, nativeSep);
+  return std::filesystem::path(strPath);
+}
+
+size_t parseTitleOverride(std::string_view source, std::string& title)
+{
+  size_t eol = source.find('\n');
+  ParseContext context;
+  context.source = source.data();
+  context.p = (char*) source.data();
+  context.eof = context.p + (eol == std::string_view::npos ? source.length() : eol);
+
+  if ((getToken(context).type == Token::TOKEN_EXPRESSION_START))
+  {
+    Token tokenTitle;
+    if (requireToken(context, Token::TOKEN_PATH, &tokenTitle)
+        && requireToken(context, Token::TOKEN_EXPRESSION_END))
+    {
+      title = std::string(tokenTitle.start, tokenTitle.end - tokenTitle.start);
+      return eol == std::string_view::npos ? source.length() : eol + 1;
+    }
+  }
+  return 0;
+}
+
+// Template compilation
+
+Field getField(std::string_view name)
+{
+  static const std::pair<std::string_view, Field> fields[] =
+  {
+    {"title", FIELD_TITLE}, {"url", FIELD_URL}, {"layout", FIELD_LAYOUT},
+    {"year", FIELD_YEAR}, {"month", FIELD_MONTH}, {"day", FIELD_DAY},
+    {"date", FIELD_DATE}, {"month_name", FIELD_MONTH_NAME},
+    {"number", FIELD_NUMBER}, {"body", FIELD_BODY},
+    {"num_pages", FIELD_NUM_PAGES}, {"prev_url", FIELD_PREV_URL},
+    {"next_url", FIELD_NEXT_URL}, {"root", FIELD_ROOT},
+  };
+
+  for (auto& field : fields)
+  {
+    if (field.first == name)
+      return field.second;
+  }
+  return FIELD_UNKNOWN;
+}
+
+// Returns the id of the given name, assigning a new one the first time it's seen.
+// Templates may be compiled from several render threads at once.
+uint32_t internSymbol(std::string_view name)
+{
+  static std::mutex mutex;
+  static std::unordered_map<std::string, uint32_t> symbols;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = symbols.find(std::string(name));
+  if (it != symbols.end())
+    return it->second;
+
+  uint32_t id = (uint32_t) symbols.size() + 1;
+  symbols.emplace(name, id);
+  return id;
+}
+
+const uint32_t SYMBOL_PAGE = internSymbol("page");
+const uint32_t SYMBOL_POST = internSymbol("post");
+
+const Pagination NO_PAGINATION;
+
+bool getScopeField(const Scope& scope, Field field, std::string_view& value)
+{
+  const Post* post = scope.post;
+  switch (field)
+  {
+    case FIELD_TITLE:       value = scope.page->title; return true;
+    case FIELD_URL:         value = scope.page->relativeUrl; return true;
+    case FIELD_LAYOUT:      if (!post) return false; value = post->layoutName; return true;
+    case FIELD_YEAR:        if (!post) return false; value = post->year; return true;
+    case FIELD_MONTH:       if (!post) return false; value = post->month; return true;
+    case FIELD_DAY:         if (!post) return false; value = post->day; return true;
+    case FIELD_DATE:        if (!post) return false; value = post->day; return true;
+    case FIELD_MONTH_NAME:  if (!post) return false; value = post->monthName; return true;
+    case FIELD_NUMBER:
+      if (scope.isLoop)
+        value = std::string_view(scope.number, scope.numberLength);
+      else if (scope.symbol == SYMBOL_PAGE)
+        value = (scope.pagination ? *scope.pagination : NO_PAGINATION).number;
+      else
+        return false;
+      return true;
+    case FIELD_NUM_PAGES:
+    case FIELD_PREV_URL:
+    case FIELD_NEXT_URL:
+    case FIELD_ROOT:
+      {
+        // Every page exposes these, so includes shared with non paginated pages can use them
+        if (scope.isLoop || scope.symbol != SYMBOL_PAGE)
+          return false;
+
+        const Pagination& pagination = scope.pagination ? *scope.pagination : NO_PAGINATION;
+        value = field == FIELD_NUM_PAGES ? pagination.numPages
+          : field == FIELD_PREV_URL ? pagination.prevUrl
+          : field == FIELD_NEXT_URL ? pagination.nextUrl
+          : pagination.root;
+        return true;
+      }
+    case FIELD_BODY:
+      if (scope.isLoop || !post) return false;
+      value = scope.body;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Looks the variable up on the render scopes, innermost first, then on the site variables.
+// Page and post urls are relative to the site root, prefix is set to the path leading back to it.
+bool findVariable(RenderContext& context, const Instruction& instruction, std::string_view& value, std::string_view& prefix)
+{
+  for (auto it = context.scopes.rbegin(); it != context.scopes.rend(); ++it)
+  {
+    if (it->symbol == instruction.symbol && getScopeField(*it, instruction.field, value))
+    {
+      if (instruction.field == FIELD_URL)
+        prefix = context.root;
+      return true;
+    }
+  }
+
+  auto siteIt = context.variables.find(instruction.name);
+  if (siteIt == context.variables.end())
+    return false;
+
+  value = siteIt->second;
+  return true;
+}
+
+std::string getSiteVariable(const std::unordered_map<std::string, std::string>& variables, const std::string& name)
+{
+  auto it = variables.find(name);
+  return it == variables.end() ? std::string() : it->second;
+}
+
+std::string resolveIncludePath(
+    std::string includedPagePath,
+    std::filesystem::path& templateRoot,
+    const std::unordered_map<std::string, std::string>& variables)
+{
+  // Replace macros from include path
+  if (includedPagePath.starts_with("$("))
+  {
+    std::string macro = "$(posts_dir)";
+    size_t macroPotion = includedPagePath.find(macro); 
+    if (macroPotion != std::string::npos)
+      includedPagePath.replace(macroPotion, macro.length(), getSiteVariable(variables, "site.posts_dir"));
+
+    macro = "$(pages_dir)";
+    macroPotion = includedPagePath.find(macro); 
+    if (macroPotion != std::string::npos)
+      includedPagePath.replace(macroPotion, macro.length(), getSiteVariable(variables, "site.pages_dir"));
+
+    macro = "$(root_dir)";
+    macroPotion = includedPagePath.find(macro); 
+    if (macroPotion != std::string::npos)
+      includedPagePath.replace(macroPotion, macro.length(), getSiteVariable(variables, "site.root_dir"));
+  }
+  else
+  {
+    // include path is relative to the current template root
+    includedPagePath = (templateRoot / includedPagePath).string();
+  }
+
+  return normalizedPathKey(strToNormalizedPath(includedPagePath));
+}
+
+bool compileExpression(ParseContext& context,
+    Template& tpl,
+    std::vector<size_t>& blockStack,
+    std::filesystem::path& templateRoot,
+    const std::unordered_map<std::string, std::string>& variables)
+{
+  // expressions MUST start with TOKEN_EXPRESSION_START
+  Token token;
+  if (!requireToken(context, Token::Type::TOKEN_EXPRESSION_START, &token))
+  {
+    return false;
+  }
+
+  token = getToken(context);
+
+  switch(token.type)
+  {
+    // VARIABLE, or ASSET when the name asset is followed by a path
+    case Token::Type::TOKEN_IDENTIFIER:
+      {
+        skipWhiteSpace(context);
+        if (std::string_view(token.start, token.end - token.start) == "asset" && peek(context) == '"')
+        {
+          if (!requireToken(context, Token::Type::TOKEN_PATH, &token))
+            return false;
+          if (!requireToken(context, Token::Type::TOKEN_EXPRESSION_END))
+            return false;
+
+          // Asset paths are relative to the assets directory. The url is looked up when rendered.
+          Instruction& instruction = tpl.instructions.emplace_back(Instruction::INSTRUCTION_ASSET);
+          instruction.name = std::filesystem::path(std::string(token.start, token.end - token.start)).lexically_normal().generic_string();
+          return true;
+        }
+
+        Instruction& instruction = tpl.instructions.emplace_back(Instruction::INSTRUCTION_VARIABLE);
+        instruction.name = std::string(token.start, token.end - token.start);
+
+        size_t dot = instruction.name.find('.');
+        if (dot != std::string::npos)
+        {
+          std::string_view name = instruction.name;
+          instruction.symbol = internSymbol(name.substr(0, dot));
+          instruction.field = getField(name.substr(dot + 1));
+        }
+        return requireToken(context, Token::Type::TOKEN_EXPRESSION_END, &token);
+      }
+      break;
+
+      // INCLUDE
+    case Token::Type::TOKEN_INCLUDE:
+      {
+        if (!requireToken(context, Token::Type::TOKEN_PATH, &token))
+          return false;
+        if (!requireToken(context, Token::Type::TOKEN_EXPRESSION_END))
+          return false;
+
+        // Included files are loaded through the template cache when rendered
+        std::string normalizedPath = resolveIncludePath(
+            std::string(token.start, token.end - token.start), templateRoot, variables);
+
+        Instruction& instruction = tpl.instructions.emplace_back(Instruction::INSTRUCTION_INCLUDE);
+        instruction.name = normalizedPath;
+        return true;
+      }
+      break;
+
+      // FOREACH
+    case Token::Type::TOKEN_FOR:
+      {
+        if (!requireToken(context, Token::Type::TOKEN_IDENTIFIER, &token))
+          return false;
+
+        Instruction instruction(Instruction::INSTRUCTION_FOR);
+        instruction.name = std::string(token.start,  token.end - token.start);
+        instruction.symbol = internSymbol(instruction.name);
+
+        if (!requireToken(context, Token::Type::TOKEN_IN, &token))
+          return false;
+
+        token = getToken(context);
+        instruction.collection = token.type;
+        if (instruction.collection != Token::Type::TOKEN_COLLECTION_PAGE
+            && instruction.collection != Token::Type::TOKEN_COLLECTION_POST)
+        {
+          logError("Uknown collection type.\n");
+          return false;
+        }
+
+        // Optional clauses: orderby_asc <field> or orderby_desc <field>,
+        // limit <n>, offset <n> and paginate <n>. limit, offset and paginate
+        // are only keywords here, elsewhere they are plain identifiers.
+        token = getToken(context);
+        while (token.type != Token::Type::TOKEN_EXPRESSION_END)
+        {
+          std::string_view clause(token.start, token.end - token.start);
+          if (token.type == Token::Type::TOKEN_ORDERBY_ASC 
+              || token.type == Token::Type::TOKEN_ORDERBY_DESC)
+          {
+            Token orderByToken;
+            instruction.orderDirection = token.type;
+
+            if (!requireToken(context, Token::Type::TOKEN_IDENTIFIER, &orderByToken))
+              return false;
+
+            instruction.orderBy = std::string(orderByToken.start, orderByToken.end - orderByToken.start);
+            instruction.orderBySymbol = internSymbol(instruction.orderBy);
+          }
+          else if (token.type == Token::Type::TOKEN_IDENTIFIER
+              && (clause == "limit" || clause == "offset" || clause == "paginate"))
+          {
+            Token numberToken;
+            if (!requireToken(context, Token::Type::TOKEN_NUMBER, &numberToken))
+              return false;
+
+            size_t value = (size_t) std::strtoull(numberToken.start, nullptr, 10);
+            if (clause == "limit")
+              instruction.limit = value;
+            else if (clause == "offset")
+              instruction.offset = value;
+            else if (value == 0)
+            {
+              logErrorFmt("%s: paginate needs at least one item per page\n", tpl.fileName.c_str());
+              return false;
+            }
+            else
+              instruction.pageSize = value;
+          }
+          else
+          {
+            logMismatchedTokenType(Token::Type::TOKEN_EXPRESSION_END, token.type);
+            return false;
+          }
+
+          token = getToken(context);
+        }
+
+        blockStack.push_back(tpl.instructions.size());
+        tpl.instructions.push_back(instruction);
+        return true;
+      }
+      break;
+
+      // FOREACH-END
+    case Token::Type::TOKEN_ENDFOR:
+      {
+        if (blockStack.empty())
+        {
+          logError("Found {{endfor}} without matching {{for}}\n");
+          return false;
+        }
+
+        size_t forIndex = blockStack.back();
+        blockStack.pop_back();
+
+        Instruction& instruction = tpl.instructions.emplace_back(Instruction::INSTRUCTION_ENDFOR);
+        instruction.jump = forIndex;
+        tpl.instructions[forIndex].jump = tpl.instructions.size() - 1;
+        return requireToken(context, Token::Type::TOKEN_EXPRESSION_END);
+      }
+      break;
+
+    default:
+      return false;
+  }
+}
+
+// Compiles tpl.source into tpl.instructions
+bool compileTemplate(
+    Template& tpl,
+    std::filesystem::path& templateRoot,
+    const std::unordered_map<std::string, std::string>& variables)
+{
+  const char* sourceStart = tpl.source.c_str();
+  const char* sourceEnd = sourceStart + tpl.source.length();
+  const char* p = sourceStart;
+  const char* writeStart = p;
+  std::vector<size_t> blockStack;
+
+  while(p < sourceEnd)
+  {
+    // Most of a template is literal html, skipped in one go up to the next expression
+    p = findExpressionStart(p, sourceEnd);
+    if (p == sourceEnd)
+      break;
+
+    if (p > writeStart)
+    {
+      Instruction& literal = tpl.instructions.emplace_back(Instruction::INSTRUCTION_LITERAL);
+      literal.start = writeStart - sourceStart;
+      literal.length = p - writeStart;
+    }
+
+    ParseContext context;
+    context.fileName = tpl.fileName.c_str();
+    context.source = p;
+    context.eof = (char*) sourceEnd;
+    context.p = (char*) context.source;
+
+    if (!compileExpression(context, tpl, blockStack, templateRoot, variables))
+    {
+      logErrorFmt("Failed to compile '%s'\n", tpl.fileName.c_str());
+      return false;
+    }
+
+    p = context.p;// we continue from where the last expression ended
+    writeStart = p; 
+  }
+
+  if (p > writeStart)
+  {
+    Instruction& literal = tpl.instructions.emplace_back(Instruction::INSTRUCTION_LITERAL);
+    literal.start = writeStart - sourceStart;
+    literal.length = p - writeStart;
+  }
+
+  if (!blockStack.empty())
+  {
+    logErrorFmt("Missing {{endfor}} on '%s'\n", tpl.fileName.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool loadTemplate(
+    Template& tpl,
+    const std::string& fileName,
+    std::filesystem::path& templateRoot,
+    const std::unordered_map<std::string, std::string>& variables,
+    size_t sourceStartOffset)
+{
+  // The template keeps its own copy of the source, literals point into it
+  FileBuffer file;
+  if (!file.open(fileName.c_str()))
+  {
+    logErrorFmt("Unable to read from template '%s'\n", fileName.c_str());
+    return false;
+  }
+
+  tpl.fileName = fileName;
+  tpl.source.assign(file.view().substr(std::min(sourceStartOffset, file.size())));
+  return compileTemplate(tpl, templateRoot, variables);
+}
+
+// Markdown files are converted to html once and then compiled as any other template
+bool loadMarkdownTemplate(
+    Template& tpl,
+    const std::string& fileName,
+    std::filesystem::path& templateRoot,
+    const std::unordered_map<std::string, std::string>& variables)
+{
+  FileBuffer markdown;
+  std::string title;
+  if (!markdown.open(fileName.c_str()))
+  {
+    logErrorFmt("Unable to read from template '%s'\n", fileName.c_str());
+    return false;
+  }
+
+  tpl.fileName = fileName;
+  TraceSpan span("markdown", fileName);
+  tpl.source = markdownToHtml(markdown.view().substr(parseTitleOverride(markdown.view(), title)));
+  return compileTemplate(tpl, templateRoot, variables);
+}
+
+Template* getTemplate(RenderContext& context, const std::string& fileName)
+{
+  std::string key = normalizedPathKey(fileName);
+  if (context.dependencies)
+    context.dependencies->files.insert(key);
+
+  {
+    std::lock_guard<std::mutex> lock(context.templateCache.mutex);
+    auto it = context.templateCache.templates.find(key);
+    if (it != context.templateCache.templates.end())
+      return &it->second;
+  }
+
+  // Compiled without holding the lock, so renders needing other templates
+  // don't wait. If another thread compiled it meanwhile, its copy is kept.
+  TraceSpan span("compile include", key);
+  Template tpl;
+  bool loaded = key.ends_with(".md") ?
+    loadMarkdownTemplate(tpl, key, context.templateRoot, context.variables) :
+    loadTemplate(tpl, key, context.templateRoot, context.variables);
+
+  if (!loaded)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(context.templateCache.mutex);
+  return &context.templateCache.templates.emplace(key, std::move(tpl)).first->second;
+}
+
+// Points the loop scope at the collection item at the given index
+void setIteratorScope(RenderContext& context, Scope& scope, const Instruction& forInstruction, size_t index, size_t number)
+{
+  if (forInstruction.collection == Token::Type::TOKEN_COLLECTION_PAGE)
+  {
+    scope.page = &context.pageList[index];
+  }
+  else
+  {
+    scope.post = &context.postList[index];
+    scope.page = scope.post;
+  }
+
+  scope.numberLength = std::to_chars(scope.number, scope.number + sizeof(scope.number), number).ptr - scope.number;
+}
+
+// Returns the collection indices in the order the for instruction iterates them
+const std::vector<size_t>& getSortedView(RenderContext& context, const Instruction& forInstruction)
+{
+  bool ascending = forInstruction.orderDirection == Token::Type::TOKEN_ORDERBY_ASC;
+  uint64_t key = ((uint64_t) forInstruction.orderBySymbol << 32)
+    | ((uint64_t) forInstruction.collection << 1) | (ascending ? 1 : 0);
+
+  std::lock_guard<std::mutex> lock(context.sortedViews.mutex);
+  auto it = context.sortedViews.views.find(key);
+  if (it != context.sortedViews.views.end())
+    return it->second;
+
+  std::vector<size_t> order = forInstruction.collection == Token::Type::TOKEN_COLLECTION_PAGE ?
+    sortedIndices(context.pageList, Page::compareBy(forInstruction.orderBy, ascending)) :
+    sortedIndices(context.postList, Post::compareBy(forInstruction.orderBy, ascending));
+
+  return context.sortedViews.views.emplace(key, std::move(order)).first->second;
+}
+
+bool renderTemplate(Template& tpl, RenderContext& context, std::string& output);
+
+bool renderInclude(const std::string& includedPagePath, RenderContext& context, std::string& output)
+{
+  TraceSpan span("include", includedPagePath);
+  Template* tpl = getTemplate(context, includedPagePath);
+  if (!tpl)
+  {
+    logErrorFmt("Unable to include file '%s'.\n", includedPagePath.c_str());
+    return false;
+  }
+
+  // A template including itself, directly or not, would never end
+  std::pmr::vector<const Template*>& includeStack = context.includeStack;
+  if (std::find(includeStack.begin(), includeStack.end(), tpl) != includeStack.end())
+  {
+    std::string chain;
+    for (const Template* includer : includeStack)
+      chain += includer->fileName + " -> ";
+    chain += tpl->fileName;
+
+    logErrorFmt("Cyclic include: %s\n", chain.c_str());
+    return false;
+  }
+
+  return renderTemplate(*tpl, context, output);
+}
+
+bool executeTemplate(Template& tpl, RenderContext& context, std::string& output);
+
+bool renderTemplate(Template& tpl, RenderContext& context, std::string& output)
+{
+  context.includeStack.push_back(&tpl);
+  bool result = executeTemplate(tpl, context, output);
+  context.includeStack.pop_back();
+  return result;
+}
+
+// Executes a compiled template, appending the result to output
+bool executeTemplate(Template& tpl, RenderContext& context, std::string& output)
+{
+  struct LoopState
+  {
+    size_t forIndex;
+    size_t iteration;
+    size_t numIterations;
+    size_t first;                     // position of the first item of the slice being iterated
+    const std::vector<size_t>* order; // collection indices in iteration order, when sorted
+  };
+
+  std::pmr::vector<LoopState> loopStack(context.arena);
+  const size_t numInstructions = tpl.instructions.size();
+  const char* source = tpl.source.c_str();
+  size_t ip = 0;
+
+  while (ip < numInstructions)
+  {
+    Instruction& instruction = tpl.instructions[ip];
+
+    switch(instruction.type)
+    {
+      case Instruction::INSTRUCTION_LITERAL:
+        {
+          output.append(source + instruction.start, instruction.length);
+          ++ip;
+        }
+        break;
+
+      case Instruction::INSTRUCTION_VARIABLE:
+        {
+          std::string_view value;
+          std::string_view prefix;
+          if (!findVariable(context, instruction, value, prefix))
+          {
+            logErrorFmt("Unknown variable '%s'\n", instruction.name.c_str());
+            output.append("UNDEFINED");
+          }
+          else
+          {
+            output.append(prefix);
+            output.append(value);
+          }
+          ++ip;
+        }
+        break;
+
+      case Instruction::INSTRUCTION_INCLUDE:
+        {
+          if (!renderInclude(instruction.name, context, output))
+            return false;
+          ++ip;
+        }
+        break;
+
+      case Instruction::INSTRUCTION_ASSET:
+        {
+          if (context.dependencies)
+            context.dependencies->usesAssets = true;
+
+          auto it = context.assetUrls.find(instruction.name);
+          if (it == context.assetUrls.end())
+          {
+            logErrorFmt("Unknown asset '%s'\n", instruction.name.c_str());
+            output.append("UNDEFINED");
+          }
+          else
+          {
+            // Asset urls are relative to the site root too
+            output.append(context.root);
+            output.append(it->second);
+          }
+          ++ip;
+        }
+        break;
+
+      case Instruction::INSTRUCTION_FOR:
+        {
+          LoopState loop = {ip, 0, 0, 0, nullptr};
+
+          if (context.dependencies)
+          {
+            context.dependencies->usesPages |= instruction.collection == Token::Type::TOKEN_COLLECTION_PAGE;
+            context.dependencies->usesPosts |= instruction.collection == Token::Type::TOKEN_COLLECTION_POST;
+          }
+
+          // Only the requested slice is iterated. A paginated loop shows the
+          // slice belonging to the page being rendered.
+          size_t collectionSize = instruction.collection == Token::Type::TOKEN_COLLECTION_PAGE ?
+            context.pageList.size() : context.postList.size();
+          size_t limit = instruction.limit;
+          loop.first = instruction.offset;
+          if (instruction.pageSize)
+          {
+            loop.first += context.pageIndex * instruction.pageSize;
+            limit = instruction.pageSize;
+          }
+          loop.numIterations = loop.first < collectionSize ? std::min(limit, collectionSize - loop.first) : 0;
+
+          if (loop.numIterations && instruction.orderDirection != Token::Type::TOKEN_UNKNOWN)
+            loop.order = &getSortedView(context, instruction);
+
+          if (loop.numIterations == 0)
+          {
+            // skip the whole block
+            ip = instruction.jump + 1;
+            break;
+          }
+
+          Scope& scope = context.scopes.emplace_back(instruction.symbol, nullptr);
+          scope.isLoop = true;
+          setIteratorScope(context, scope, instruction, loop.order ? (*loop.order)[loop.first] : loop.first, 0);
+          loopStack.push_back(loop);
+          ++ip;
+        }
+        break;
+
+      case Instruction::INSTRUCTION_ENDFOR:
+        {
+          LoopState& loop = loopStack.back();
+          Instruction& forInstruction = tpl.instructions[loop.forIndex];
+
+          if (++loop.iteration < loop.numIterations)
+          {
+            size_t position = loop.first + loop.iteration;
+            size_t index = loop.order ? (*loop.order)[position] : position;
+            setIteratorScope(context, context.scopes.back(), forInstruction, index, loop.iteration);
+            ip = loop.forIndex + 1;
+            break;
+          }
+
+          context.scopes.pop_back();
+          loopStack.pop_back();
+          ++ip;
+        }
+        break;
+    }
+  }
+
+  return true;
+}
+
+bool processPage(Template& tpl, RenderContext& context, std::string& output)
+{
+  bool result = renderTemplate(tpl, context, output);
+
+  if (!result)
+  {
+    logErrorFmt("Failed to process '%s'\n", tpl.fileName.c_str());
+  }
+
+  return result;
+}
+
+bool renderTemplateSource(
+    const std::string& source,
+    std::filesystem::path& templateRoot,
+    const std::unordered_map<std::string, std::string>& variables,
+    std::string& output)
+{
+  static const std::vector<Page> noPages;
+  static const std::vector<Post> noPosts;
+  static const std::unordered_map<std::string, std::string> noAssets;
+  TemplateCache templateCache;
+  SortedViews sortedViews;
+
+  Template tpl;
+  tpl.fileName = "<source>";
+  tpl.source = source;
+  if (!compileTemplate(tpl, templateRoot, variables))
+    return false;
+
+  std::pmr::memory_resource* arena = std::pmr::get_default_resource();
+  RenderContext context = {templateRoot, variables, noPages, noPosts, templateCache, sortedViews, noAssets,
+    std::pmr::vector<Scope>(arena), nullptr, std::pmr::vector<const Template*>(arena), 0, arena, std::string_view()};
+  return processPage(tpl, context, output);
+}
+
+// Url of the given page (0 based) of a paginated page. The first one is the
+// page itself, the following ones go to page/2.html, page/3.html, ... next to
+// the index or under a directory named after any other page.
+std::string getPaginationUrl(const std::string& relativeUrl, size_t pageIndex)
+{
+  if (pageIndex == 0)
+    return relativeUrl;
+
+  std::string url = relativeUrl == "index.html" ? std::string() : relativeUrl.substr(0, relativeUrl.rfind('.')) + "/";
+  return url + "page/" + std::to_string(pageIndex + 1) + ".html";
+}
+
+std::string getRootPath(const std::string& relativeUrl)
+{
+  std::string root;
+  for (size_t i = relativeUrl.find('/'); i != std::string::npos; i = relativeUrl.find('/', i + 1))
+    root += "../";
+  return root;
+}
+
+size_t countPaginationPages(const Template& tpl, RenderContext& context)
+{
+  for (const Instruction& instruction : tpl.instructions)
+  {
+    if (instruction.type == Instruction::INSTRUCTION_INCLUDE)
+    {
+      // Missing and cyclic includes are reported when rendering
+      const Template* included = getTemplate(context, instruction.name);
+      std::pmr::vector<const Template*>& includeStack = context.includeStack;
+      if (!included || std::find(includeStack.begin(), includeStack.end(), included) != includeStack.end())
+        continue;
+
+      includeStack.push_back(included);
+      size_t numPages = countPaginationPages(*included, context);
+      includeStack.pop_back();
+      if (numPages)
+        return numPages;
+      continue;
+    }
+
+    if (instruction.type != Instruction::INSTRUCTION_FOR || !instruction.pageSize)
+      continue;
+
+    size_t collectionSize = instruction.collection == Token::Type::TOKEN_COLLECTION_PAGE ?
+      context.pageList.size() : context.postList.size();
+    size_t numItems = collectionSize > instruction.offset ? collectionSize - instruction.offset : 0;
+    return std::max((size_t) 1, (numItems + instruction.pageSize - 1) / instruction.pageSize);
+  }
+  return 0;
+}
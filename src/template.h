@@ -0,0 +1,198 @@
+#ifndef TEMPLATE
+#define TEMPLATE
+
+#include <cstdint>
+#include <filesystem>
+#include <memory_resource>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "page.h"
+#include "parser_utils.h"
+
+// Variables are written as "<scope>.<field>" (post.title, it.url). Scope names
+// are interned to integer ids and fields to an enum when templates are compiled,
+// so renders resolve them without building or hashing strings.
+enum Field
+{
+  FIELD_UNKNOWN     = 0,
+  FIELD_TITLE       = 1,
+  FIELD_URL         = 2,
+  FIELD_LAYOUT      = 3,
+  FIELD_YEAR        = 4,
+  FIELD_MONTH       = 5,
+  FIELD_DAY         = 6,
+  FIELD_DATE        = 7,
+  FIELD_MONTH_NAME  = 8,
+  FIELD_NUMBER      = 9,
+  FIELD_BODY        = 10,
+  FIELD_NUM_PAGES   = 11,
+  FIELD_PREV_URL    = 12,
+  FIELD_NEXT_URL    = 13,
+  FIELD_ROOT        = 14,
+};
+
+struct Instruction
+{
+  enum Type
+  {
+    INSTRUCTION_LITERAL   = 0,  // Copy a span of the template source to the output
+    INSTRUCTION_VARIABLE  = 1,  // Output the value of a variable
+    INSTRUCTION_INCLUDE   = 2,  // Render another template file in place
+    INSTRUCTION_FOR       = 3,  // Start of a for block
+    INSTRUCTION_ENDFOR    = 4,  // End of a for block
+    INSTRUCTION_ASSET     = 5,  // Output the url of an asset
+  };
+
+  Type type;
+  size_t start = 0;   // LITERAL: offset of the span on the template source
+  size_t length = 0;  // LITERAL: length of the span
+  std::string name;   // VARIABLE: variable name. INCLUDE: file path. FOR: iterator name. ASSET: asset path
+  std::string orderBy;
+  Token::Type collection = Token::Type::TOKEN_UNKNOWN;
+  Token::Type orderDirection = Token::Type::TOKEN_UNKNOWN;
+  size_t jump = 0;    // FOR: index of the matching ENDFOR. ENDFOR: index of the matching FOR
+  uint32_t symbol = 0;          // VARIABLE: interned scope name. FOR: interned iterator name
+  uint32_t orderBySymbol = 0;   // FOR: interned sort key
+  size_t offset = 0;            // FOR: first item of the collection to iterate
+  size_t limit = SIZE_MAX;      // FOR: maximum number of items to iterate
+  size_t pageSize = 0;          // FOR: items per page when the loop paginates its page
+  Field field = FIELD_UNKNOWN;  // VARIABLE: field read from the scope
+
+  Instruction(Type type): type(type) {}
+};
+
+// A template file compiled to a flat list of instructions. Literal
+// instructions point into the source, so it must live as long as the template.
+struct Template
+{
+  std::string fileName;
+  std::string source;
+  std::vector<Instruction> instructions;
+};
+
+// Compiled templates are kept for the whole build, so layouts and included
+// files are parsed only once no matter how many times they are rendered.
+struct TemplateCache
+{
+  std::unordered_map<std::string, Template> templates;
+  std::mutex mutex;
+};
+
+// Sorted index views of the page and post lists, one per collection, sort
+// key and direction. Each view is computed the first time a loop asks for it
+// and then shared read-only by every render of the build.
+struct SortedViews
+{
+  std::unordered_map<uint64_t, std::vector<size_t>> views;
+  std::mutex mutex;
+};
+
+// Files and collections a render depended on. Watch mode uses it to find
+// which outputs must be rendered again when a file changes.
+struct RenderDependencies
+{
+  std::set<std::string> files;
+  bool usesPages = false;
+  bool usesPosts = false;
+  bool usesAssets = false;
+};
+
+// Where a paginated page is among the pages its collection was split into.
+// Urls are relative to the page being rendered.
+struct Pagination
+{
+  std::string number = "1";
+  std::string numPages = "1";
+  std::string prevUrl;
+  std::string nextUrl;
+  std::string root;     // path from the page back to the site root
+};
+
+// A named set of variables visible while rendering. Scopes point at the page
+// or post they expose instead of copying its fields. Loop iterators get a
+// scope pushed by for and popped by the matching endfor.
+struct Scope
+{
+  uint32_t symbol = 0;
+  const Page* page = nullptr;   // title and url
+  const Post* post = nullptr;   // layout and date fields, when the scope is a post
+  std::string_view body;        // post.body
+  const Pagination* pagination = nullptr;  // page.xxx pagination fields
+  bool isLoop = false;
+  char number[24];              // loop iteration, as text
+  size_t numberLength = 0;
+
+  Scope(uint32_t symbol, const Page* page, const Post* post = nullptr):
+    symbol(symbol), page(page), post(post) {}
+};
+
+// Everything needed to render one page or post. Site wide data is shared
+// read-only between renders while variables set during the render (page.xxx,
+// post.xxx and loop iterators) live in the render's own scopes.
+struct RenderContext
+{
+  std::filesystem::path& templateRoot;
+  const std::unordered_map<std::string, std::string>& variables;
+  const std::vector<Page>& pageList;
+  const std::vector<Post>& postList;
+  TemplateCache& templateCache;
+  SortedViews& sortedViews;
+  const std::unordered_map<std::string, std::string>& assetUrls;  // output url by asset path
+  std::pmr::vector<Scope> scopes;  // Innermost last
+  RenderDependencies* dependencies = nullptr;
+  std::pmr::vector<const Template*> includeStack;  // Templates being rendered, outermost first
+  size_t pageIndex = 0;  // Page being rendered, when the page is paginated
+  std::pmr::memory_resource* arena;  // Temporaries of this render
+  std::string_view root;  // Path from the output being rendered back to the site root
+};
+
+extern const uint32_t SYMBOL_PAGE;
+extern const uint32_t SYMBOL_POST;
+
+bool requireToken(ParseContext& context, Token::Type requiredType, Token* tokenFound = nullptr);
+
+// Paths are used as keys on caches and watch mode lookups, so the same file must always produce the same key
+std::string normalizedPathKey(const std::filesystem::path& path);
+
+std::filesystem::path strToNormalizedPath(std::string& strPath);
+
+// Parses the title override block, if present on the first line of source.
+// Returns the offset where the content starts after it, or 0 if there is no title override.
+size_t parseTitleOverride(std::string_view source, std::string& title);
+
+bool loadTemplate(
+    Template& tpl,
+    const std::string& fileName,
+    std::filesystem::path& templateRoot,
+    const std::unordered_map<std::string, std::string>& variables,
+    size_t sourceStartOffset = 0);
+
+// Returns the compiled template for the given file, compiling it the first
+// time it's requested. Markdown files are cached already converted to html.
+Template* getTemplate(RenderContext& context, const std::string& fileName);
+
+bool processPage(Template& tpl, RenderContext& context, std::string& output);
+
+// Compiles source as a template of templateRoot and renders it with the given
+// variables and empty page and post collections. Used by the benchmarks.
+bool renderTemplateSource(
+    const std::string& source,
+    std::filesystem::path& templateRoot,
+    const std::unordered_map<std::string, std::string>& variables,
+    std::string& output);
+
+// Url of the given page (0 based) of a paginated page
+std::string getPaginationUrl(const std::string& relativeUrl, size_t pageIndex);
+
+// Path from the output at the given url back to the site root
+std::string getRootPath(const std::string& relativeUrl);
+
+// Number of pages needed to show the collection of the first paginated loop
+// of the template, looking into its includes too. 0 when there is none.
+size_t countPaginationPages(const Template& tpl, RenderContext& context);
+
+#endif  // TEMPLATE
@@ -0,0 +1,62 @@
+// Minifier tests
+//
+// Each case minifies a small document and compares it with the expected
+// output. Returns non zero if any case fails.
+
+#include <string>
+#include <stdio.h>
+#include "../minify.h"
+
+struct MinifyCase
+{
+  const char* name;
+  const char* html;
+  const char* expected;
+};
+
+static const MinifyCase CASES[] =
+{
+  {
+    "whitespace between inline list items is kept",
+    "<ul class=\"menu\">\n  <li>Home</li>\n  <li>About</li>\n</ul>",
+    "<ul class=\"menu\"> <li>Home</li> <li>About</li> </ul>",
+  },
+  {
+    "whitespace around head elements is dropped",
+    "<!DOCTYPE html>\n<html>\n<head>\n  <title>T</title>\n  <meta charset=\"utf-8\">\n</head>\n<body>\n  <p>Hi  there</p>\n</body>\n</html>\n",
+    "<!DOCTYPE html><html><head><title>T</title><meta charset=\"utf-8\"></head><body><p>Hi there</p></body></html>",
+  },
+  {
+    "whitespace between table rows is dropped",
+    "<table>\n  <tr><td>a</td></tr>\n  <tr><td>b</td></tr>\n</table>",
+    "<table><tr><td>a</td></tr><tr><td>b</td></tr></table>",
+  },
+  {
+    "comments are dropped, conditional comments kept",
+    "<p>a <!-- note --> b</p><!--[if IE]><p>old</p><![endif]-->",
+    "<p>a b</p><!--[if IE]><p>old</p><![endif]-->",
+  },
+  {
+    "raw elements end at their own closing tag only",
+    "<pre>  x </prefix>  y </pre>  <p>z</p>",
+    "<pre>  x </prefix>  y </pre> <p>z</p>",
+  },
+};
+
+int main()
+{
+  int numFailed = 0;
+  for (const MinifyCase& test : CASES)
+  {
+    std::string out;
+    minifyHtml(test.html, out);
+    if (out == test.expected)
+      continue;
+
+    printf("FAILED: %s\n  expected: %s\n  got:      %s\n", test.name, test.expected, out.c_str());
+    numFailed++;
+  }
+
+  printf("%zu minify cases, %d failed\n", sizeof(CASES) / sizeof(CASES[0]), numFailed);
+  return numFailed ? 1 : 0;
+}
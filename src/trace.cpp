@@ -0,0 +1,168 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdio.h>
+#include "parser_utils.h"
+#include "trace.h"
+
+struct TraceEvent
+{
+  const char* name;
+  std::string detail;
+  int64_t start;      // microseconds since tracing was enabled
+  int64_t duration;
+};
+
+// Each thread appends to its own buffer. Buffers are owned by the registry so
+// spans of worker threads outlive the threads. Buffers of finished threads
+// are dropped once written.
+struct ThreadTrace
+{
+  uint32_t threadId;
+  bool finished = false;
+  std::vector<TraceEvent> events;
+};
+
+static std::atomic<bool> traceEnabled = false;
+static std::chrono::steady_clock::time_point traceStart;
+static std::mutex threadTracesMutex;
+static std::vector<std::unique_ptr<ThreadTrace>> threadTraces;
+static uint32_t nextThreadId = 1;
+
+// Flags the buffer of a thread as finished when the thread exits
+struct ThreadTraceOwner
+{
+  ThreadTrace* threadTrace = nullptr;
+
+  ~ThreadTraceOwner()
+  {
+    if (!threadTrace)
+      return;
+
+    std::lock_guard<std::mutex> lock(threadTracesMutex);
+    threadTrace->finished = true;
+  }
+};
+
+static int64_t traceNow()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - traceStart).count();
+}
+
+static ThreadTrace& getThreadTrace()
+{
+  thread_local ThreadTraceOwner owner;
+  if (!owner.threadTrace)
+  {
+    std::lock_guard<std::mutex> lock(threadTracesMutex);
+    threadTraces.push_back(std::make_unique<ThreadTrace>());
+    owner.threadTrace = threadTraces.back().get();
+    owner.threadTrace->threadId = nextThreadId++;
+  }
+  return *owner.threadTrace;
+}
+
+void enableTrace()
+{
+  traceStart = std::chrono::steady_clock::now();
+  traceEnabled = true;
+}
+
+bool isTraceEnabled()
+{
+  return traceEnabled;
+}
+
+std::string traceDetail(const std::filesystem::path& path)
+{
+  return traceEnabled ? path.string() : std::string();
+}
+
+static void appendJsonString(std::string& json, std::string_view text)
+{
+  json += '"';
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+    {
+      json += '\\';
+      json += c;
+    }
+    else if ((unsigned char) c < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      json += escaped;
+    }
+    else
+    {
+      json += c;
+    }
+  }
+  json += '"';
+}
+
+bool writeTrace(const char* fileName)
+{
+  std::string json = "{\"traceEvents\":[\n";
+  bool first = true;
+  {
+    std::lock_guard<std::mutex> lock(threadTracesMutex);
+    for (auto& threadTrace : threadTraces)
+    {
+      for (const TraceEvent& event : threadTrace->events)
+      {
+        if (!first)
+          json += ",\n";
+        first = false;
+
+        char fields[128];
+        snprintf(fields, sizeof(fields), "{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld,\"name\":",
+            threadTrace->threadId, (long long) event.start, (long long) event.duration);
+        json += fields;
+        appendJsonString(json, event.name);
+        if (!event.detail.empty())
+        {
+          json += ",\"args\":{\"file\":";
+          appendJsonString(json, event.detail);
+          json += '}';
+        }
+        json += '}';
+      }
+      threadTrace->events.clear();
+    }
+
+    std::erase_if(threadTraces, [](auto& threadTrace) { return threadTrace->finished; });
+  }
+  json += "\n]}\n";
+
+  FILE* file = fopen(fileName, "wb");
+  if (!file)
+  {
+    logErrorFmt("Could not write to file %s\n", fileName);
+    return false;
+  }
+
+  bool written = fwrite(json.c_str(), 1, json.length(), file) == json.length();
+  return fclose(file) == 0 && written;
+}
+
+TraceSpan::TraceSpan(const char* name, std::string_view detail): name(name), start(-1)
+{
+  if (!traceEnabled)
+    return;
+
+  this->detail = detail;
+  start = traceNow();
+}
+
+TraceSpan::~TraceSpan()
+{
+  if (start < 0)
+    return;
+
+  int64_t end = traceNow();
+  getThreadTrace().events.push_back({name, std::move(detail), start, end - start});
+}
@@ -0,0 +1,43 @@
+#ifndef TRACE
+#define TRACE
+
+#include <stdint.h>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Build tracing
+//
+// Spans are recorded per thread while tracing is enabled and written as
+// Chrome trace event JSON, which chrome://tracing and Perfetto can open.
+// When tracing is disabled a span costs a single flag check. Details that need
+// building, like path strings, go through traceDetail so they aren't built then.
+
+void enableTrace();
+
+bool isTraceEnabled();
+
+// Writes every span recorded since the last write and clears them, so watch
+// mode doesn't keep spans of every rebuild. Returns false if the file can't be written.
+bool writeTrace(const char* fileName);
+
+// The path as a span detail when tracing is enabled, an empty string otherwise
+std::string traceDetail(const std::filesystem::path& path);
+
+// Records the time between its construction and destruction as a span named
+// name on the calling thread. The detail, usually a file name, is shown as
+// the span argument.
+struct TraceSpan
+{
+  TraceSpan(const char* name, std::string_view detail = std::string_view());
+  ~TraceSpan();
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  const char* name;
+  std::string detail;
+  int64_t start;
+};
+
+#endif  // TRACE
@@ -0,0 +1,320 @@
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+#include "watch.h"
+#include "assets.h"
+#include "parser_utils.h"
+#include "site.h"
+#include "trace.h"
+
+#ifdef __linux__
+
+// Watch mode
+//
+// Keeps the Site loaded and listens to inotify events on the site config,
+// template and posts directories. Events are coalesced and only the outputs
+// that depend on the changed files are rendered again.
+
+const int WATCH_COALESCE_MS = 100;
+const uint32_t WATCH_EVENT_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF;
+
+struct WatchedDirectory
+{
+  std::filesystem::path path;
+  bool onlySiteConfig;  // The site root is watched only for changes to site.txt
+};
+
+void addWatch(int fd, std::unordered_map<int, WatchedDirectory>& watches, const std::filesystem::path& path, bool recursive, bool onlySiteConfig)
+{
+  if (!std::filesystem::is_directory(path))
+    return;
+
+  int wd = inotify_add_watch(fd, path.string().c_str(), WATCH_EVENT_MASK);
+  if (wd < 0)
+  {
+    logErrorFmt("Unable to watch directory '%s'\n", path.string().c_str());
+    return;
+  }
+
+  // The same directory might be watched for different reasons. Keep the broadest one.
+  auto it = watches.find(wd);
+  if (it == watches.end() || !onlySiteConfig)
+    watches[wd] = {path, onlySiteConfig};
+
+  if (!recursive)
+    return;
+
+  std::error_code error;
+  for (auto& entry : std::filesystem::recursive_directory_iterator(path, error))
+  {
+    if (entry.is_directory())
+    {
+      int subWd = inotify_add_watch(fd, entry.path().string().c_str(), WATCH_EVENT_MASK);
+      if (subWd >= 0)
+        watches[subWd] = {entry.path(), false};
+    }
+  }
+}
+
+bool isInsideDirectory(const std::string& path, const std::filesystem::path& directory)
+{
+  std::string dir = normalizedPathKey(directory);
+  return path.starts_with(dir) && (path.length() == dir.length() || path[dir.length()] == std::filesystem::path::preferred_separator);
+}
+
+// Re-renders whatever depends on the changed files. Returns false if any render failed.
+bool rebuildSite(Site& site, const std::set<std::string>& changedFiles, bool structureChanged)
+{
+  TraceSpan span("rebuild");
+  auto start = std::chrono::system_clock::now();
+  auto isChanged = [&](const std::string& path) { return changedFiles.count(normalizedPathKey(path)) != 0; };
+
+  // A new site config might change anything. Start over.
+  if (isChanged(site.siteConfigFile.string()))
+  {
+    logInfo("Site config changed. Reloading site ...\n");
+    site.templateCache.templates.clear();
+    site.markdownCache.clear();
+    site.dependencies.clear();
+    bool hasWarnings = false;
+    bool success = loadSite(site);
+    success = collectPages(site) && success;
+    success = collectPosts(site, hasWarnings) && success;
+    collectSiteAssets(site);
+    success = renderSite(site, nullptr) && success;
+    copyAssets(site);
+    return success;
+  }
+
+  bool assetsChanged = false;
+  for (const std::string& path : changedFiles)
+  {
+    site.templateCache.templates.erase(path);
+    site.markdownCache.erase(path);
+    if (isInsideDirectory(path, site.templateDirectory / "assets")
+        || isInsideDirectory(path, site.postsDirectory / "assets"))
+      assetsChanged = true;
+  }
+
+  // Template cache and markdown cache keys are not always normalized
+  std::erase_if(site.templateCache.templates, [&](auto& it) { return isChanged(it.first); });
+  std::erase_if(site.markdownCache, [&](auto& it) { return isChanged(it.first); });
+
+  // Find out if the page or post collections changed. Loops over a changed
+  // collection must be rendered again.
+  bool pagesChanged = false;
+  bool postsChanged = false;
+  bool success = true;
+
+  if (structureChanged)
+  {
+    std::vector<Page> oldPages = site.pageList;
+    std::vector<Post> oldPosts = site.postList;
+    bool hasWarnings = false;
+    success = collectPages(site) && success;
+    success = collectPosts(site, hasWarnings) && success;
+
+    pagesChanged = oldPages.size() != site.pageList.size();
+    for (size_t i = 0; !pagesChanged && i < oldPages.size(); i++)
+    {
+      const Page& a = oldPages[i];
+      const Page& b = site.pageList[i];
+      pagesChanged = a.sourceFileName != b.sourceFileName || a.title != b.title || a.relativeUrl != b.relativeUrl;
+    }
+
+    postsChanged = oldPosts.size() != site.postList.size();
+    for (size_t i = 0; !postsChanged && i < oldPosts.size(); i++)
+    {
+      const Post& a = oldPosts[i];
+      const Post& b = site.postList[i];
+      postsChanged = a.sourceFileName != b.sourceFileName || a.title != b.title || a.relativeUrl != b.relativeUrl
+        || a.layoutName != b.layoutName || a.year != b.year || a.month != b.month || a.day != b.day;
+    }
+  }
+  else
+  {
+    // Files were only modified. The title override is the only thing that might have changed.
+    for (Page& page : site.pageList)
+    {
+      if (!isChanged(page.sourceFileName))
+        continue;
+
+      std::string fileName = std::filesystem::path(page.sourceFileName).filename().string();
+      std::string title = fileName.substr(0, fileName.find("."));
+      size_t sourceStartOffset = 0;
+      readTitleOverride(page.sourceFileName, title, &sourceStartOffset);
+      page.sourceStartOffset = sourceStartOffset;
+      if (title != page.title)
+      {
+        page.title = title;
+        pagesChanged = true;
+      }
+    }
+
+    for (Post& post : site.postList)
+    {
+      if (!isChanged(post.sourceFileName))
+        continue;
+
+      std::string title = post.title;
+      loadPostTitle(post);
+      postsChanged |= title != post.title;
+    }
+  }
+
+  // Outputs linking assets are rendered again when an asset url changes,
+  // like a fingerprint after an edit or an asset being added or removed
+  bool assetUrlsChanged = false;
+  if (assetsChanged)
+  {
+    std::unordered_map<std::string, std::string> oldAssetUrls = std::move(site.assetUrls);
+    collectSiteAssets(site);
+    assetUrlsChanged = oldAssetUrls != site.assetUrls;
+  }
+
+  // Flag outputs affected by the changes
+  const size_t numPages = site.pageList.size();
+  const size_t numJobs = numPages + site.postList.size();
+  std::vector<bool> dirty(numJobs, false);
+  size_t numDirty = 0;
+
+  for (size_t i = 0; i < numJobs; i++)
+  {
+    const Page& page = i < numPages ? site.pageList[i] : site.postList[i - numPages];
+    auto it = site.dependencies.find(page.relativeUrl);
+
+    bool isDirty = it == site.dependencies.end() || isChanged(page.sourceFileName);
+    if (!isDirty)
+    {
+      const RenderDependencies& dependencies = it->second;
+      isDirty = (pagesChanged && dependencies.usesPages) || (postsChanged && dependencies.usesPosts)
+        || (assetUrlsChanged && dependencies.usesAssets);
+      for (auto file = dependencies.files.begin(); !isDirty && file != dependencies.files.end(); ++file)
+        isDirty = isChanged(*file);
+    }
+
+    dirty[i] = isDirty;
+    if (isDirty)
+      numDirty++;
+  }
+
+  if (numDirty || structureChanged)
+    success = renderSite(site, &dirty) && success;
+
+  if (assetsChanged)
+    copyAssets(site);
+
+  auto end = std::chrono::system_clock::now();
+  auto rebuildTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+  logInfoFmt("Rebuilt %zu of %zu outputs in %ldms\n", numDirty, numJobs, (long) rebuildTime);
+  return success;
+}
+
+int watchSite(Site& site)
+{
+  int fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0)
+  {
+    logError("Unable to initialize inotify\n");
+    return 1;
+  }
+
+  std::unordered_map<int, WatchedDirectory> watches;
+  addWatch(fd, watches, site.inputDirectory, false, true);
+  addWatch(fd, watches, site.templateDirectory, true, false);
+  addWatch(fd, watches, site.layoutDirectory, true, false);
+  addWatch(fd, watches, site.postsDirectory, true, false);
+
+  logInfo("Watching for changes. Press Ctrl+C to stop.\n");
+
+  alignas(inotify_event) char buffer[64 * 1024];
+  std::string siteConfigName = site.siteConfigFile.filename().string();
+
+  while (true)
+  {
+    std::set<std::string> changedFiles;
+    bool structureChanged = false;
+
+    // Block until something happens, then keep reading until events stop
+    // arriving for a while, so a burst of events causes a single rebuild.
+    int timeout = -1;
+    flushLog();
+    while (true)
+    {
+      pollfd pfd = {fd, POLLIN, 0};
+      int ready = poll(&pfd, 1, timeout);
+      if (ready < 0 && errno == EINTR)
+        continue;
+      if (ready <= 0)
+        break;
+
+      ssize_t length = read(fd, buffer, sizeof(buffer));
+      if (length <= 0)
+        break;
+
+      for (char* p = buffer; p < buffer + length; )
+      {
+        inotify_event* event = (inotify_event*) p;
+        p += sizeof(inotify_event) + event->len;
+
+        auto it = watches.find(event->wd);
+        if (it == watches.end())
+          continue;
+
+        if (event->mask & IN_IGNORED)
+        {
+          watches.erase(it);
+          continue;
+        }
+
+        if (event->len == 0)
+          continue;
+
+        const WatchedDirectory& watched = it->second;
+        if (watched.onlySiteConfig && siteConfigName != event->name)
+          continue;
+
+        std::filesystem::path path = watched.path / event->name;
+        if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && (event->mask & IN_ISDIR))
+          addWatch(fd, watches, path, true, false);
+
+        if (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+          structureChanged = true;
+
+        changedFiles.insert(normalizedPathKey(path));
+      }
+
+      timeout = WATCH_COALESCE_MS;
+    }
+
+    if (!changedFiles.empty())
+    {
+      rebuildSite(site, changedFiles, structureChanged);
+      if (!site.options.traceFileName.empty())
+        writeTrace(site.options.traceFileName.c_str());
+    }
+  }
+
+  close(fd);
+  return 0;
+}
+
+#else
+
+int watchSite(Site& site)
+{
+  (void) site;
+  logError("Watch mode is only supported on Linux\n");
+  return 1;
+}
+
+#endif  // __linux__
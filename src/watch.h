@@ -0,0 +1,10 @@
+#ifndef WATCH
+#define WATCH
+
+struct Site;
+
+// Keeps running after the build and renders again whatever depends on the
+// source files that change. Only supported on Linux.
+int watchSite(Site& site);
+
+#endif  // WATCH